@@ -1,14 +1,115 @@
 #include <string>
+#include <filesystem>
+#include <iostream>
+#include <cstdlib>
 
 #include "src/pipeline/assistant.h"
+#include "src/server/session_server.h"
 
-int main() {
+// "<backend>[:path]", e.g. "device", "null", "wav:question.wav", "pipe:-"
+static bool parseAudioArg(const std::string& value, AudioIOConfig& config) {
+    size_t colon = value.find(':');
+    if (colon != std::string::npos) config.path = value.substr(colon + 1);
+    return parseAudioBackend(value.substr(0, colon), config.backend);
+}
+
+static void usage() {
+    std::cerr << "usage: jarvis [--input <backend>[:path]] [--output <backend>[:path]]\n"
+                 "              [--period-frames N] [--periods N] [--no-realtime] [--half-duplex] [--no-barge-in]\n"
+                 "              [--draft-model <gguf>]\n"
+                 "       jarvis --server <port> [--sessions 8]\n"
+                 "backends: device (default), wav, null, loopback, pipe (raw s16le, \"-\" is stdin/stdout)\n"
+                 "with --output pipe:- everything else printed goes to stderr\n";
+}
+
+// Text only: the LLM is shared by every connection, speech stays with the
+// single-user pipeline. See SessionServer for the protocol.
+static int runServer(const std::string& llama_model, int port, int sessions) {
+    static const char* SERVER_SYSTEM_PROMPT =
+        "<|im_start|>system\n"
+        "You are Jarvis, a helpful assistant. Answer in plain text, briefly and conversationally."
+        "<|im_end|>\n";
+
+    BatchedInferenceConfig config;
+    config.max_sessions = sessions;
+    BatchedInference llm;
+    if (!llm.init(llama_model, config) || !llm.setSystemPrompt(SERVER_SYSTEM_PROMPT)) {
+        std::cerr << "Failed to init LLM\n";
+        return 1;
+    }
+
+    SessionServerConfig serverConfig;
+    serverConfig.port = static_cast<uint16_t>(port);
+    SessionServer server(llm);
+    if (!server.start(serverConfig)) return 1;
+
+    llm.start();
+    std::cout << "Serving " << sessions << " sessions on 127.0.0.1:" << port << "\n";
+    server.run();
+    llm.shutdown();
+    return 0;
+}
+
+int main(int argc, char** argv) {
     Assistant jarvis;
 
+    // Audio I/O, the sound card unless told otherwise
+    AudioIOConfig input;
+    AudioIOConfig output;
+    PipelineConfig pipeline;
+    int serverPort = 0;
+    int sessions = 8;
+    std::string draft_model;    // e.g. a Qwen3 0.6B GGUF, empty disables speculative decoding
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-realtime") {
+            input.realtime = output.realtime = false;
+            continue;
+        }
+        if (arg == "--half-duplex") {
+            // stop listening while a reply plays, for open speakers
+            pipeline.listen_while_speaking = false;
+            continue;
+        }
+        if (arg == "--no-barge-in") {
+            // replies always play to the end, talking over them queues the next turn
+            pipeline.barge_in = false;
+            continue;
+        }
+        if (i + 1 >= argc) { usage(); return 1; }
+        std::string value = argv[++i];
+        bool ok = true;
+        if      (arg == "--input")         ok = parseAudioArg(value, input);
+        else if (arg == "--output")        ok = parseAudioArg(value, output);
+        else if (arg == "--period-frames") input.period_frames = output.period_frames = std::atoi(value.c_str());
+        else if (arg == "--periods")       input.periods = output.periods = std::atoi(value.c_str());
+        else if (arg == "--server")        serverPort = std::atoi(value.c_str());
+        else if (arg == "--sessions")      sessions = std::atoi(value.c_str());
+        else if (arg == "--draft-model")   draft_model = value;
+        else ok = false;
+        if (!ok) { usage(); return 1; }
+    }
+
+    // speech on stdout: take it over before anything is printed, the
+    // console output carries on through stderr
+    if (output.backend == AudioBackend::Pipe && (output.path.empty() || output.path == "-") && !audioStdout()) {
+        std::cerr << "Failed to redirect stdout\n";
+        return 1;
+    }
+
+    // one buffer serves both ends when we listen to ourselves
+    LoopbackBuffer loopback(16000);
+    input.loopback = &loopback;
+    output.loopback = &loopback;
+
     // Model paths
     const std::string whisper_model = "models/ggml-medium-q8_0.bin";
     const std::string llama_model   = "models/Qwen3-VL-4B-Instruct-Q4_1.gguf";
 
+    if (serverPort > 0) {
+        return runServer(llama_model, serverPort, sessions);
+    }
+
     // Piper TTS config
     PiperConfig piper;
     piper.model    = "models/vits-piper-en_US-glados/en_US-glados.onnx";
@@ -22,10 +123,19 @@ int main() {
     kokoro.data_dir = "models/kokoro-int8-multi-lang-v1_0/espeak-ng-data";
     kokoro.voices   = "models/kokoro-int8-multi-lang-v1_0/voices.bin";
 
-    if (!jarvis.init(whisper_model, llama_model, piper, kokoro)) {
+    if (!jarvis.init(whisper_model, llama_model, draft_model, piper, kokoro, input, output)) {
         return 1;
     }
 
+    // RAG is optional, build the index with jarvis_rag_build first
+    RagConfig rag;
+    rag.embed_model = "models/nomic-embed-text-v1.5.Q8_0.gguf";
+    rag.index_dir   = "rag_index";
+    if (std::filesystem::exists(rag.index_dir)) {
+        jarvis.enableRag(rag);
+    }
+
+    jarvis.setPipelineConfig(pipeline);
     jarvis.run();
     jarvis.shutdown();
     return 0;
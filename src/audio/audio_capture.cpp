@@ -6,6 +6,11 @@
 
 AudioCapture::AudioCapture() {
 	// ring buffer initialized in start()
+	config.sample_rate = SAMPLE_RATE;
+}
+
+AudioCapture::AudioCapture(const AudioIOConfig& cfg) : config(cfg) {
+	config.sample_rate = SAMPLE_RATE;
 }
 
 AudioCapture::~AudioCapture() {
@@ -13,36 +18,36 @@ AudioCapture::~AudioCapture() {
 }
 
 bool AudioCapture::start() {
-	// Initialize ring buffer
-	ma_uint32 rbSize = SAMPLE_RATE * BUFFER_SECONDS * sizeof(float);
-	ma_result result = ma_pcm_rb_init(ma_format_f32, CHANNELS, rbSize, nullptr, nullptr, &rb);
+	if (isRunning) {
+		flush();
+		return true;
+	}
+
+	// Initialize ring buffer, its size is in frames
+	ma_uint32 rbFrames = SAMPLE_RATE * BUFFER_SECONDS;
+	ma_result result = ma_pcm_rb_init(ma_format_f32, CHANNELS, rbFrames, nullptr, nullptr, &rb);
 	if (result != MA_SUCCESS) {
 		std::cerr << "Failed to initialize ring buffer." << std::endl;
 		return false;
 
 	}
-	// Configure device
-	ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
-	deviceConfig.capture.format   = ma_format_f32;
-	deviceConfig.capture.channels = CHANNELS;
-	deviceConfig.sampleRate       = SAMPLE_RATE;
-	deviceConfig.dataCallback     = dataCallback;
-	deviceConfig.pUserData        = this;
-
-	// Initialize device
-	if (ma_device_init(nullptr, &deviceConfig, &device) != MA_SUCCESS) {
-		std::cerr << "Failed to initialize audio device." << std::endl;
-		ma_device_uninit(&device);
+	framesCaptured = 0;
+	framesDropped = 0;
+	overruns = 0;
+	maxFill = 0;
+
+	// Open the configured backend, the sound card unless told otherwise
+	source = createAudioSource(config);
+	if (!source || !source->start(dataCallback, this)) {
+		delete source;
+		source = nullptr;
 		ma_pcm_rb_uninit(&rb);
 		return false;
 	}
 
-	// Start device
-	if (ma_device_start(&device) != MA_SUCCESS) {
-		std::cerr << "Failed to start audio device." << std::endl;
-		ma_device_uninit(&device);
-		ma_pcm_rb_uninit(&rb);
-		return false;
+	if (config.backend != AudioBackend::Device) {
+		std::cout << "Capturing from " << source->name()
+			<< (config.path.empty() ? "" : " " + config.path) << "\n";
 	}
 
 	isRunning = true;
@@ -51,8 +56,9 @@ bool AudioCapture::start() {
 
 void AudioCapture::stop() {
 	if (isRunning) {
-		ma_device_stop(&device);
-		ma_device_uninit(&device);
+		source->stop();
+		delete source;
+		source = nullptr;
 		ma_pcm_rb_uninit(&rb);
 		isRunning = false;
 		audioAvailable.notify_all(); // wake up any waiting threads
@@ -60,30 +66,42 @@ void AudioCapture::stop() {
 	}
 }
 
-// STATIC callback - called by miniaudio from audio thread
-void AudioCapture::dataCallback(ma_device* pDevice, void* pOutput,
-	const void* pInput, ma_uint32 frameCount) {
-	// Get 'this' pointer from user data
-	AudioCapture* capture = static_cast<AudioCapture*>(pDevice->pUserData);
+bool AudioCapture::finished() {
+	return isRunning && source->finished() && ma_pcm_rb_available_read(&rb) == 0;
+}
 
-	if (pInput == nullptr) return;
+// STATIC callback - called from the source's audio thread
+void AudioCapture::dataCallback(void* user, const float* samples, uint32_t frameCount) {
+	AudioCapture* capture = static_cast<AudioCapture*>(user);
 
-	// Write incoming audio to ring buffer
-	void* pWriteBuffer;
-	ma_uint32 framesToWrite = frameCount;
+	// Write incoming audio to ring buffer, in two parts when it wraps
+	ma_uint32 written = 0;
+	for (int part = 0; part < 2 && written < frameCount; part++) {
+		void* pWriteBuffer;
+		ma_uint32 framesToWrite = frameCount - written;
 
-	ma_pcm_rb_acquire_write(&capture->rb, &framesToWrite, &pWriteBuffer);
+		ma_pcm_rb_acquire_write(&capture->rb, &framesToWrite, &pWriteBuffer);
+		if (framesToWrite == 0) break;
 
-	if (framesToWrite > 0) {
-		memcpy(pWriteBuffer, pInput,
+		memcpy(pWriteBuffer, samples + written,
 			framesToWrite * ma_get_bytes_per_frame(ma_format_f32, CHANNELS));
 		ma_pcm_rb_commit_write(&capture->rb, framesToWrite);
+		written += framesToWrite;
+	}
+
+	// the reader fell behind by more than the ring holds, the rest is lost
+	capture->framesCaptured.fetch_add(frameCount, std::memory_order_relaxed);
+	if (written < frameCount) {
+		capture->framesDropped.fetch_add(frameCount - written, std::memory_order_relaxed);
+		capture->overruns.fetch_add(1, std::memory_order_relaxed);
+	}
+	ma_uint32 fill = ma_pcm_rb_available_read(&capture->rb);
+	if (fill > capture->maxFill.load(std::memory_order_relaxed)) {
+		capture->maxFill.store(fill, std::memory_order_relaxed);
 	}
 
 	// Signal that new audio is available
 	capture->audioAvailable.notify_one();
-
-	(void)pOutput; // Unused for capture
 }
 
 ma_uint32 AudioCapture::readSamples(float* outputBuffer, ma_uint32 maxFrames) {
@@ -101,6 +119,44 @@ ma_uint32 AudioCapture::readSamples(float* outputBuffer, ma_uint32 maxFrames) {
 	return framesToRead;
 }
 
+ma_uint32 AudioCapture::acquireRead(const float** samples, ma_uint32 maxFrames) {
+	void* pReadBuffer = nullptr;
+	ma_uint32 framesToRead = maxFrames;
+
+	ma_pcm_rb_acquire_read(&rb, &framesToRead, &pReadBuffer);
+	*samples = static_cast<const float*>(pReadBuffer);
+	return framesToRead;
+}
+
+void AudioCapture::commitRead(ma_uint32 frames) {
+	ma_pcm_rb_commit_read(&rb, frames);
+}
+
+CaptureStats AudioCapture::stats() const {
+	CaptureStats s;
+	s.frames = framesCaptured.load(std::memory_order_relaxed);
+	s.dropped_frames = framesDropped.load(std::memory_order_relaxed);
+	s.overruns = overruns.load(std::memory_order_relaxed);
+	s.max_fill = maxFill.load(std::memory_order_relaxed);
+	s.capacity = SAMPLE_RATE * BUFFER_SECONDS;
+	return s;
+}
+
+void AudioCapture::flush() {
+	if (!isRunning) return;
+
+	// consumer side only, safe while the callback keeps writing
+	ma_uint32 frames = ma_pcm_rb_available_read(&rb);
+	while (frames > 0) {
+		void* pReadBuffer;
+		ma_uint32 chunk = frames;
+		ma_pcm_rb_acquire_read(&rb, &chunk, &pReadBuffer);
+		if (chunk == 0) break;
+		ma_pcm_rb_commit_read(&rb, chunk);
+		frames -= chunk;
+	}
+}
+
 ma_uint32 AudioCapture::availableFrames() {
 	return ma_pcm_rb_available_read(&rb);
 }
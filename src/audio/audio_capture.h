@@ -2,25 +2,52 @@
 #define AUDIO_CAPTURE_H
 
 #include "miniaudio.h"
+#include "audio_io.h"
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <cstdint>
+
+// ring buffer health since start()
+struct CaptureStats {
+    uint64_t frames = 0;            // delivered by the source
+    uint64_t dropped_frames = 0;    // lost because the ring was full
+    uint64_t overruns = 0;          // callbacks that lost some
+    ma_uint32 max_fill = 0;         // most frames ever waiting to be read
+    ma_uint32 capacity = 0;
+};
 
 class AudioCapture {
 public:
-    // constructor and destructor
+    // constructor and destructor, capture always runs at 16 kHz mono
     AudioCapture();
+    explicit AudioCapture(const AudioIOConfig& config);
     ~AudioCapture();
 
-    // initialize and start audio capture
+    // initialize and start audio capture; the source then stays open for
+    // the session and a second call only drops what was buffered
     bool start();
 
-    // stop capture
+    // stop capture and release the source
     void stop();
 
+    // a file or pipe source has ended and everything it delivered was read
+    bool finished();
+
+    // discard buffered audio, e.g. whatever was recorded while we were talking
+    void flush();
+
     // get available samples and returns number of frames read
     ma_uint32 readSamples(float* outputBuffer, ma_uint32 maxFrames);
 
+    // zero-copy read: points samples at up to maxFrames buffered frames in
+    // the ring and returns how many. They stay valid and are not overwritten
+    // until commitRead(); one reader at a time.
+    ma_uint32 acquireRead(const float** samples, ma_uint32 maxFrames);
+    void commitRead(ma_uint32 frames);
+
+    CaptureStats stats() const;
+
     // check if audio is available
     ma_uint32 availableFrames();
 
@@ -30,17 +57,24 @@ public:
 
 
 private:
-    ma_device device{};
+    AudioIOConfig config;
+    AudioSource* source = nullptr;
     ma_pcm_rb rb{};
     std::atomic<bool> isRunning{ false };
 
+    // written by the audio thread
+    std::atomic<uint64_t> framesCaptured{ 0 };
+    std::atomic<uint64_t> framesDropped{ 0 };
+    std::atomic<uint64_t> overruns{ 0 };
+    std::atomic<ma_uint32> maxFill{ 0 };
+
     // config
     static constexpr ma_uint32 CHANNELS = 1;        // Mono for Whisper
     static constexpr ma_uint32 SAMPLE_RATE = 16000; // 16kHz for Whisper
     static constexpr ma_uint32 BUFFER_SECONDS = 5;
 
-    // static callback
-    static void dataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+    // static callback, runs on the source's audio thread
+    static void dataCallback(void* user, const float* samples, uint32_t frameCount);
 };
 
 #endif
\ No newline at end of file
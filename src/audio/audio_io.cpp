@@ -0,0 +1,601 @@
+#include "audio_io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "miniaudio.h"
+#include "wav_io.h"
+
+static uint32_t periodFrames(const AudioIOConfig& config) {
+    return config.period_frames > 0 ? config.period_frames : std::max(1u, config.sample_rate / 100);
+}
+
+static void toFloat(const int16_t* in, float* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = in[i] / 32768.0f;
+}
+
+// Clock for the backends without a sound card. tick() runs once per period
+// when realtime, back to back otherwise, and returns the frames it moved:
+// 0 when there was nothing to do, -1 once the stream has ended.
+class PeriodThread {
+public:
+    ~PeriodThread() { stop(); }
+
+    void start(const AudioIOConfig& config, std::function<int()> tick) {
+        const auto period = std::chrono::microseconds(
+            static_cast<int64_t>(periodFrames(config)) * 1000000 / std::max(1u, config.sample_rate));
+        const bool realtime = config.realtime;
+
+        running_ = true;
+        thread_ = std::thread([this, period, realtime, tick = std::move(tick)] {
+            auto next = std::chrono::steady_clock::now();
+            while (running_.load(std::memory_order_relaxed)) {
+                int moved = tick();
+                if (moved < 0) break;
+
+                if (realtime) {
+                    next += period;
+                    auto now = std::chrono::steady_clock::now();
+                    // after a stall (blocking pipe, debugger) resume from now instead of bursting
+                    if (now > next + 4 * period) next = now;
+                    std::this_thread::sleep_until(next);
+                } else if (moved == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        });
+    }
+
+    void stop() {
+        running_ = false;
+        if (thread_.joinable()) thread_.join();
+    }
+
+private:
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+};
+
+// --- miniaudio ---
+
+class DeviceSource : public AudioSource {
+public:
+    explicit DeviceSource(const AudioIOConfig& config) : config_(config) {}
+    ~DeviceSource() override { stop(); }
+
+    bool start(AudioSourceCallback callback, void* user) override {
+        callback_ = callback;
+        user_ = user;
+
+        ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
+        deviceConfig.capture.format     = ma_format_f32;
+        deviceConfig.capture.channels   = 1;
+        deviceConfig.sampleRate         = config_.sample_rate;
+        deviceConfig.periodSizeInFrames = config_.period_frames;
+        deviceConfig.periods            = config_.periods;
+        deviceConfig.dataCallback       = dataCallback;
+        deviceConfig.pUserData          = this;
+
+        if (ma_device_init(nullptr, &deviceConfig, &device_) != MA_SUCCESS) {
+            std::cerr << "Failed to initialize audio device." << std::endl;
+            return false;
+        }
+        if (ma_device_start(&device_) != MA_SUCCESS) {
+            std::cerr << "Failed to start audio device." << std::endl;
+            ma_device_uninit(&device_);
+            return false;
+        }
+        running_ = true;
+        return true;
+    }
+
+    void stop() override {
+        if (!running_) return;
+        ma_device_stop(&device_);
+        ma_device_uninit(&device_);
+        running_ = false;
+    }
+
+    const char* name() const override { return "device"; }
+
+private:
+    static void dataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+        (void)pOutput;
+        DeviceSource* self = static_cast<DeviceSource*>(pDevice->pUserData);
+        if (pInput) self->callback_(self->user_, static_cast<const float*>(pInput), frameCount);
+    }
+
+    AudioIOConfig config_;
+    ma_device device_{};
+    bool running_ = false;
+    AudioSourceCallback callback_ = nullptr;
+    void* user_ = nullptr;
+};
+
+class DeviceSink : public AudioSink {
+public:
+    explicit DeviceSink(const AudioIOConfig& config) : config_(config) {}
+    ~DeviceSink() override { stop(); }
+
+    bool start(AudioSinkCallback callback, void* user) override {
+        callback_ = callback;
+        user_ = user;
+
+        ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+        deviceConfig.playback.format    = ma_format_s16;
+        deviceConfig.playback.channels  = 1;
+        deviceConfig.sampleRate         = config_.sample_rate;
+        deviceConfig.periodSizeInFrames = config_.period_frames;
+        deviceConfig.periods            = config_.periods;
+        deviceConfig.dataCallback       = dataCallback;
+        deviceConfig.pUserData          = this;
+
+        if (ma_device_init(nullptr, &deviceConfig, &device_) != MA_SUCCESS) {
+            std::cerr << "Failed to initialize playback device\n";
+            return false;
+        }
+        if (ma_device_start(&device_) != MA_SUCCESS) {
+            std::cerr << "Failed to start playback device\n";
+            ma_device_uninit(&device_);
+            return false;
+        }
+        running_ = true;
+        return true;
+    }
+
+    void stop() override {
+        if (!running_) return;
+        ma_device_uninit(&device_);
+        running_ = false;
+    }
+
+    const char* name() const override { return "device"; }
+
+private:
+    static void dataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+        (void)pInput;
+        DeviceSink* self = static_cast<DeviceSink*>(pDevice->pUserData);
+        self->callback_(self->user_, static_cast<int16_t*>(pOutput), frameCount);
+    }
+
+    AudioIOConfig config_;
+    ma_device device_{};
+    bool running_ = false;
+    AudioSinkCallback callback_ = nullptr;
+    void* user_ = nullptr;
+};
+
+// --- null ---
+
+class NullSource : public AudioSource {
+public:
+    explicit NullSource(const AudioIOConfig& config) : config_(config), silence_(periodFrames(config), 0.0f) {}
+    ~NullSource() override { stop(); }
+
+    bool start(AudioSourceCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            callback(user, silence_.data(), static_cast<uint32_t>(silence_.size()));
+            return static_cast<int>(silence_.size());
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    const char* name() const override { return "null"; }
+
+private:
+    AudioIOConfig config_;
+    std::vector<float> silence_;
+    PeriodThread thread_;
+};
+
+class NullSink : public AudioSink {
+public:
+    explicit NullSink(const AudioIOConfig& config) : config_(config), scratch_(periodFrames(config)) {}
+    ~NullSink() override { stop(); }
+
+    bool start(AudioSinkCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            return static_cast<int>(callback(user, scratch_.data(), static_cast<uint32_t>(scratch_.size())));
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    const char* name() const override { return "null"; }
+
+private:
+    AudioIOConfig config_;
+    std::vector<int16_t> scratch_;
+    PeriodThread thread_;
+};
+
+// --- wav file ---
+
+class WavFileSource : public AudioSource {
+public:
+    explicit WavFileSource(const AudioIOConfig& config) : config_(config), period_(periodFrames(config)) {}
+    ~WavFileSource() override { stop(); }
+
+    bool open() {
+        if (!readWav(config_.path, config_.sample_rate, samples_)) return false;
+        // trailing silence lets the endpointing see the end of the last utterance
+        samples_.resize(samples_.size() + static_cast<size_t>(config_.tail_seconds * config_.sample_rate), 0.0f);
+        return true;
+    }
+
+    bool start(AudioSourceCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            if (pos_ >= samples_.size()) {
+                finished_ = true;
+                return -1;
+            }
+            uint32_t n = static_cast<uint32_t>(std::min<size_t>(period_, samples_.size() - pos_));
+            callback(user, samples_.data() + pos_, n);
+            pos_ += n;
+            return static_cast<int>(n);
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    bool finished() const override { return finished_.load(std::memory_order_acquire); }
+    const char* name() const override { return "wav"; }
+
+private:
+    AudioIOConfig config_;
+    uint32_t period_;
+    std::vector<float> samples_;
+    size_t pos_ = 0;
+    std::atomic<bool> finished_{false};
+    PeriodThread thread_;
+};
+
+// records only what was played, gaps between replies are left out
+class WavFileSink : public AudioSink {
+public:
+    explicit WavFileSink(const AudioIOConfig& config) : config_(config), scratch_(periodFrames(config)) {}
+    ~WavFileSink() override {
+        stop();
+        if (open_) ma_encoder_uninit(&encoder_);
+    }
+
+    bool open() {
+        ma_encoder_config encoderConfig = ma_encoder_config_init(ma_encoding_format_wav, ma_format_s16, 1, config_.sample_rate);
+        if (ma_encoder_init_file(config_.path.c_str(), &encoderConfig, &encoder_) != MA_SUCCESS) {
+            std::cerr << "Failed to write " << config_.path << "\n";
+            return false;
+        }
+        open_ = true;
+        return true;
+    }
+
+    bool start(AudioSinkCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            uint32_t got = callback(user, scratch_.data(), static_cast<uint32_t>(scratch_.size()));
+            if (got > 0) ma_encoder_write_pcm_frames(&encoder_, scratch_.data(), got, nullptr);
+            return static_cast<int>(got);
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    const char* name() const override { return "wav"; }
+
+private:
+    AudioIOConfig config_;
+    std::vector<int16_t> scratch_;
+    ma_encoder encoder_{};
+    bool open_ = false;
+    PeriodThread thread_;
+};
+
+// --- loopback ---
+
+LoopbackBuffer::LoopbackBuffer(uint32_t sample_rate, float seconds) : sample_rate_(sample_rate) {
+    ring_.init(static_cast<size_t>(sample_rate * seconds));
+}
+
+class LoopbackSource : public AudioSource {
+public:
+    explicit LoopbackSource(const AudioIOConfig& config)
+        : config_(config), buffer_(config.loopback), scratch_(periodFrames(config)) {}
+    ~LoopbackSource() override { stop(); }
+
+    bool start(AudioSourceCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            size_t got = buffer_->read(scratch_.data(), scratch_.size());
+            if (got == 0 && buffer_->closed()) {
+                finished_ = true;
+                return -1;
+            }
+            // paced like a microphone: a full period every tick, silence when nothing was written
+            if (config_.realtime) {
+                std::fill(scratch_.begin() + got, scratch_.end(), 0.0f);
+                got = scratch_.size();
+            }
+            if (got > 0) callback(user, scratch_.data(), static_cast<uint32_t>(got));
+            return static_cast<int>(got);
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    bool finished() const override { return finished_.load(std::memory_order_acquire); }
+    const char* name() const override { return "loopback"; }
+
+private:
+    AudioIOConfig config_;
+    LoopbackBuffer* buffer_;
+    std::vector<float> scratch_;
+    std::atomic<bool> finished_{false};
+    PeriodThread thread_;
+};
+
+class LoopbackSink : public AudioSink {
+public:
+    explicit LoopbackSink(const AudioIOConfig& config)
+        : config_(config), buffer_(config.loopback), pcm_(periodFrames(config)), samples_(pcm_.size()) {}
+    ~LoopbackSink() override {
+        stop();
+        if (resampling_) ma_linear_resampler_uninit(&resampler_, nullptr);
+    }
+
+    bool open() {
+        if (config_.sample_rate == buffer_->sampleRate()) return true;
+
+        ma_linear_resampler_config resamplerConfig =
+            ma_linear_resampler_config_init(ma_format_f32, 1, config_.sample_rate, buffer_->sampleRate());
+        if (ma_linear_resampler_init(&resamplerConfig, nullptr, &resampler_) != MA_SUCCESS) {
+            std::cerr << "Failed to create loopback resampler\n";
+            return false;
+        }
+        resampling_ = true;
+        resampled_.resize(static_cast<size_t>(pcm_.size()) * buffer_->sampleRate() / config_.sample_rate + 16);
+        return true;
+    }
+
+    bool start(AudioSinkCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            uint32_t got = callback(user, pcm_.data(), static_cast<uint32_t>(pcm_.size()));
+            if (got == 0) return 0;
+
+            toFloat(pcm_.data(), samples_.data(), got);
+            if (!resampling_) {
+                buffer_->write(samples_.data(), got);
+                return static_cast<int>(got);
+            }
+
+            ma_uint64 in = got;
+            ma_uint64 out = resampled_.size();
+            ma_linear_resampler_process_pcm_frames(&resampler_, samples_.data(), &in, resampled_.data(), &out);
+            // a full buffer drops the overflow, the reader was not keeping up
+            buffer_->write(resampled_.data(), static_cast<size_t>(out));
+            return static_cast<int>(got);
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    const char* name() const override { return "loopback"; }
+
+private:
+    AudioIOConfig config_;
+    LoopbackBuffer* buffer_;
+    std::vector<int16_t> pcm_;
+    std::vector<float> samples_;
+    std::vector<float> resampled_;
+    ma_linear_resampler resampler_{};
+    bool resampling_ = false;
+    PeriodThread thread_;
+};
+
+// --- raw s16le pipe ---
+
+static bool isStdio(const std::string& path) {
+    return path.empty() || path == "-";
+}
+
+FILE* audioStdout() {
+    static FILE* out = [] {
+        fflush(stdout);
+        std::cout.flush();
+#ifdef _WIN32
+        int fd = _dup(_fileno(stdout));
+        if (fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0) return static_cast<FILE*>(nullptr);
+        _setmode(fd, _O_BINARY);
+        return _fdopen(fd, "wb");
+#else
+        int fd = dup(STDOUT_FILENO);
+        if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) return static_cast<FILE*>(nullptr);
+        return fdopen(fd, "wb");
+#endif
+    }();
+    return out;
+}
+
+// a blocking read holds up stop() until the writer sends more or closes the pipe
+class PipeSource : public AudioSource {
+public:
+    explicit PipeSource(const AudioIOConfig& config)
+        : config_(config), pcm_(periodFrames(config)), samples_(pcm_.size()),
+          tail_(static_cast<size_t>(config.tail_seconds * config.sample_rate)) {}
+    ~PipeSource() override {
+        stop();
+        if (file_ && file_ != stdin) fclose(file_);
+    }
+
+    bool open() {
+        file_ = isStdio(config_.path) ? stdin : fopen(config_.path.c_str(), "rb");
+        if (!file_) {
+            std::cerr << "Failed to open " << config_.path << "\n";
+            return false;
+        }
+        if (config_.periods > 0) {
+            setvbuf(file_, nullptr, _IOFBF, static_cast<size_t>(pcm_.size()) * config_.periods * sizeof(int16_t));
+        }
+        return true;
+    }
+
+    bool start(AudioSourceCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            size_t got = ended_ ? 0 : fread(pcm_.data(), sizeof(int16_t), pcm_.size(), file_);
+            if (got < pcm_.size()) ended_ = true;
+            toFloat(pcm_.data(), samples_.data(), got);
+
+            // same trailing silence as a file once the writer hangs up
+            if (ended_) {
+                size_t pad = std::min(samples_.size() - got, tail_);
+                std::fill(samples_.begin() + got, samples_.begin() + got + pad, 0.0f);
+                got += pad;
+                tail_ -= pad;
+                if (got == 0) {
+                    finished_ = true;
+                    return -1;
+                }
+            }
+            callback(user, samples_.data(), static_cast<uint32_t>(got));
+            return static_cast<int>(got);
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    bool finished() const override { return finished_.load(std::memory_order_acquire); }
+    const char* name() const override { return "pipe"; }
+
+private:
+    AudioIOConfig config_;
+    FILE* file_ = nullptr;
+    std::vector<int16_t> pcm_;
+    std::vector<float> samples_;
+    size_t tail_;
+    bool ended_ = false;
+    std::atomic<bool> finished_{false};
+    PeriodThread thread_;
+};
+
+// only played samples are written, a reader like aplay fills gaps itself
+class PipeSink : public AudioSink {
+public:
+    explicit PipeSink(const AudioIOConfig& config) : config_(config), pcm_(periodFrames(config)) {}
+    ~PipeSink() override {
+        stop();
+        if (file_ && !stdio_) fclose(file_);
+    }
+
+    bool open() {
+        stdio_ = isStdio(config_.path);
+        file_ = stdio_ ? audioStdout() : fopen(config_.path.c_str(), "wb");
+        if (!file_) {
+            std::cerr << "Failed to open " << (stdio_ ? "stdout" : config_.path) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool start(AudioSinkCallback callback, void* user) override {
+        thread_.start(config_, [this, callback, user] {
+            uint32_t got = callback(user, pcm_.data(), static_cast<uint32_t>(pcm_.size()));
+            if (got > 0) {
+                fwrite(pcm_.data(), sizeof(int16_t), got, file_);
+                fflush(file_);
+            }
+            return static_cast<int>(got);
+        });
+        return true;
+    }
+
+    void stop() override { thread_.stop(); }
+    const char* name() const override { return "pipe"; }
+
+private:
+    AudioIOConfig config_;
+    FILE* file_ = nullptr;
+    bool stdio_ = false;    // audioStdout() lives as long as the process
+    std::vector<int16_t> pcm_;
+    PeriodThread thread_;
+};
+
+// --- factories ---
+
+template<typename T>
+static T* openOrDelete(T* backend) {
+    if (backend->open()) return backend;
+    delete backend;
+    return nullptr;
+}
+
+AudioSource* createAudioSource(const AudioIOConfig& config) {
+    switch (config.backend) {
+        case AudioBackend::Device:
+            return new DeviceSource(config);
+        case AudioBackend::WavFile:
+            return openOrDelete(new WavFileSource(config));
+        case AudioBackend::Null:
+            return new NullSource(config);
+        case AudioBackend::Loopback:
+            if (!config.loopback || config.loopback->sampleRate() != config.sample_rate) {
+                std::cerr << "Loopback source needs a LoopbackBuffer at " << config.sample_rate << " Hz\n";
+                return nullptr;
+            }
+            return new LoopbackSource(config);
+        case AudioBackend::Pipe:
+            return openOrDelete(new PipeSource(config));
+    }
+    return nullptr;
+}
+
+AudioSink* createAudioSink(const AudioIOConfig& config) {
+    switch (config.backend) {
+        case AudioBackend::Device:
+            return new DeviceSink(config);
+        case AudioBackend::WavFile:
+            return openOrDelete(new WavFileSink(config));
+        case AudioBackend::Null:
+            return new NullSink(config);
+        case AudioBackend::Loopback:
+            if (!config.loopback) {
+                std::cerr << "Loopback sink needs a LoopbackBuffer\n";
+                return nullptr;
+            }
+            return openOrDelete(new LoopbackSink(config));
+        case AudioBackend::Pipe:
+            return openOrDelete(new PipeSink(config));
+    }
+    return nullptr;
+}
+
+const char* audioBackendName(AudioBackend backend) {
+    switch (backend) {
+        case AudioBackend::Device:   return "device";
+        case AudioBackend::WavFile:  return "wav";
+        case AudioBackend::Null:     return "null";
+        case AudioBackend::Loopback: return "loopback";
+        case AudioBackend::Pipe:     return "pipe";
+    }
+    return "?";
+}
+
+bool parseAudioBackend(const std::string& name, AudioBackend& out) {
+    for (AudioBackend backend : { AudioBackend::Device, AudioBackend::WavFile, AudioBackend::Null,
+                                  AudioBackend::Loopback, AudioBackend::Pipe }) {
+        if (name == audioBackendName(backend)) {
+            out = backend;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,106 @@
+#ifndef AUDIO_IO_H
+#define AUDIO_IO_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spsc_ring.h"
+
+// Where capture audio comes from and where speech goes. Sources deliver mono
+// float samples, sinks pull mono int16, both at the configured sample rate.
+enum class AudioBackend {
+    Device,     // miniaudio, the default sound card
+    WavFile,    // source: decode a file (any format miniaudio reads), sink: write a 16-bit WAV
+    Null,       // source: silence, sink: discard
+    Loopback,   // in-memory, a sink writes into a LoopbackBuffer and a source reads it back
+    Pipe        // raw s16le PCM, source reads stdin, sink writes stdout ("-" or a path/fifo)
+};
+
+class LoopbackBuffer;
+
+struct AudioIOConfig {
+    AudioBackend backend = AudioBackend::Device;
+    uint32_t sample_rate = 16000;
+
+    // Device: miniaudio period size and count, 0 keeps miniaudio's low latency defaults.
+    // Others: frames moved per tick (10 ms when 0), periods sizes the pipe's stdio buffer.
+    uint32_t period_frames = 0;
+    uint32_t periods = 0;
+
+    // Non-device backends run one period per period duration, like a sound
+    // card would. false moves audio as fast as the other side allows; capture
+    // drops what it cannot buffer, so sources feeding it should stay realtime.
+    bool realtime = true;
+
+    std::string path;                   // WavFile and Pipe
+    float tail_seconds = 1.0f;          // WavFile/Pipe source: silence after the end so the VAD can close the turn
+    LoopbackBuffer* loopback = nullptr; // Loopback, shared by the sink and the source, not owned
+};
+
+// fill count samples, called from the backend's audio thread
+using AudioSourceCallback = void (*)(void* user, const float* samples, uint32_t count);
+// write count samples, pad with silence and return how many held audio
+using AudioSinkCallback = uint32_t (*)(void* user, int16_t* out, uint32_t count);
+
+class AudioSource {
+public:
+    virtual ~AudioSource() {}
+
+    virtual bool start(AudioSourceCallback callback, void* user) = 0;
+    virtual void stop() = 0;
+
+    // files and pipes end, devices do not
+    virtual bool finished() const { return false; }
+
+    virtual const char* name() const = 0;
+};
+
+class AudioSink {
+public:
+    virtual ~AudioSink() {}
+
+    virtual bool start(AudioSinkCallback callback, void* user) = 0;
+    virtual void stop() = 0;
+
+    virtual const char* name() const = 0;
+};
+
+// Samples written by a loopback sink and read back by a loopback source, e.g.
+// to feed our own speech into capture. Single producer, single consumer.
+class LoopbackBuffer {
+public:
+    explicit LoopbackBuffer(uint32_t sample_rate = 16000, float seconds = 10.0f);
+
+    uint32_t sampleRate() const { return sample_rate_; }
+
+    // the rate the data arrives at may differ, it is resampled on the way in
+    size_t write(const float* samples, size_t n) { return ring_.write(samples, n); }
+    size_t read(float* out, size_t n) { return ring_.read(out, n); }
+    size_t size() const { return ring_.size(); }
+
+    // closed loopbacks report finished() once drained
+    void close() { closed_.store(true, std::memory_order_release); }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    uint32_t sample_rate_;
+    SpscRing<float> ring_;
+    std::atomic<bool> closed_{false};
+};
+
+// nullptr (and a message on stderr) when the config is unusable, the caller owns the result
+AudioSource* createAudioSource(const AudioIOConfig& config);
+AudioSink* createAudioSink(const AudioIOConfig& config);
+
+// The stream a stdio pipe sink writes PCM to. The first call moves the real
+// stdout to a new descriptor and points descriptor 1 at stderr, so console
+// output from us or the libraries can no longer end up in the audio. Call it
+// before anything is printed when speech goes to "pipe:-".
+FILE* audioStdout();
+
+const char* audioBackendName(AudioBackend backend);
+bool parseAudioBackend(const std::string& name, AudioBackend& out);
+
+#endif
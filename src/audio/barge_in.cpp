@@ -0,0 +1,28 @@
+#include "barge_in.h"
+
+#include <algorithm>
+
+bool BargeInDetector::process(float micLevel, float outputLevel, float noiseFloor, size_t samples, int sampleRate) {
+    const float ms = 1000.0f * static_cast<float>(samples) / static_cast<float>(sampleRate);
+
+    const float echo = coupling_ * outputLevel + noiseFloor;
+    const bool talking = micLevel > config_.min_speech_level && micLevel > config_.echo_margin * echo;
+
+    if (talking) {
+        speechMs_ += ms;
+    } else {
+        // pauses between words should not start the count over
+        speechMs_ = std::max(0.0f, speechMs_ - ms * 0.5f);
+
+        // Only the reply is audible, learn how loud its echo is. Downwards
+        // fast, a quieter room is safe to trust; upwards slowly, so one loud
+        // chunk can't make the user inaudible.
+        if (outputLevel >= config_.min_output_level) {
+            float ratio = std::max(0.0f, micLevel - noiseFloor) / outputLevel;
+            float rate = ratio < coupling_ ? 0.3f : 0.05f;
+            coupling_ += rate * (ratio - coupling_);
+        }
+    }
+
+    return speechMs_ >= static_cast<float>(config_.min_speech_ms);
+}
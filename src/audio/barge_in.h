@@ -0,0 +1,41 @@
+#ifndef BARGE_IN_H
+#define BARGE_IN_H
+
+#include <cstddef>
+
+// Tells the user talking over a reply apart from the reply's own echo.
+// Without echo cancellation the microphone hears the speakers, so plain VAD
+// would interrupt on every reply. Instead the mic level is compared with
+// what the echo of the current output level should be: the ratio between
+// the two (the coupling) is learned while only the reply is audible, and
+// speech has to stay well above the prediction for a while to count.
+struct BargeInConfig {
+    float echo_margin = 2.0f;         // mic must be this many times the predicted echo (6 dB)
+    float initial_coupling = 0.5f;    // mic / output level until it has been measured
+    float min_output_level = 0.005f;  // quieter output is too noisy to learn the coupling from
+    float min_speech_level = 0.01f;   // absolute floor, as VoiceActivityDetector::speechThreshold
+    int min_speech_ms = 300;          // how long the user has to talk over the reply
+};
+
+class BargeInDetector {
+public:
+    explicit BargeInDetector(const BargeInConfig& config = BargeInConfig())
+        : config_(config), coupling_(config.initial_coupling) {}
+
+    // start of a reply, the learned coupling is kept
+    void reset() { speechMs_ = 0.0f; }
+
+    // One capture chunk: its rms, the loudest output level over the same
+    // stretch of time, the room's noise floor and the chunk length. Returns
+    // true once the user has been talking over the reply long enough.
+    bool process(float micLevel, float outputLevel, float noiseFloor, size_t samples, int sampleRate);
+
+    float coupling() const { return coupling_; }
+
+private:
+    BargeInConfig config_;
+    float coupling_;
+    float speechMs_ = 0.0f;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Lock-free ring between exactly one producer thread and one consumer thread.
+// Storage is allocated by init() and never touched again, so read() and write()
+// are safe to call from a real-time audio callback: no locks, no allocation.
+template<typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "ring elements are copied with memcpy");
+
+public:
+    // capacity is rounded up to a power of two; not thread safe
+    void init(size_t capacity) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        if (cap != buffer_.size()) {
+            buffer_.assign(cap, T{});
+            mask_ = cap - 1;
+        }
+        clear();
+    }
+
+    // only while neither side is running
+    void clear() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return buffer_.size(); }
+
+    // elements ready to read, exact on the consumer side
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    // free slots, exact on the producer side
+    size_t space() const { return capacity() - size(); }
+
+    // producer: copies up to n elements, returns how many fit
+    size_t write(const T* src, size_t n) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        n = std::min(n, capacity() - (head - tail));
+        if (n == 0) return 0;
+
+        const size_t at = head & mask_;
+        const size_t first = std::min(n, capacity() - at);
+        memcpy(buffer_.data() + at, src, first * sizeof(T));
+        memcpy(buffer_.data(), src + first, (n - first) * sizeof(T));
+
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer: copies up to n elements, returns how many were available
+    size_t read(T* dst, size_t n) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        n = std::min(n, head - tail);
+        if (n == 0) return 0;
+
+        const size_t at = tail & mask_;
+        const size_t first = std::min(n, capacity() - at);
+        memcpy(dst, buffer_.data() + at, first * sizeof(T));
+        memcpy(dst + first, buffer_.data(), (n - first) * sizeof(T));
+
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // consumer: drops everything readable right now, returns how much
+    size_t discard() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        tail_.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_ = 0;
+
+    // positions only grow, wrapping is handled by the mask; separate cache
+    // lines keep the two threads from bouncing one line back and forth
+    alignas(64) std::atomic<size_t> head_{0};   // written by the producer
+    alignas(64) std::atomic<size_t> tail_{0};   // written by the consumer
+};
+
+#endif
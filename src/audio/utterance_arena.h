@@ -0,0 +1,200 @@
+#ifndef UTTERANCE_ARENA_H
+#define UTTERANCE_ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <vector>
+
+// One utterance of captured audio in a buffer sized once. Capture appends,
+// whisper reads the span written so far while capture keeps going: once the
+// utterance has begun, samples are never moved or overwritten until the
+// arena goes back to its pool, so the reader needs no copy. One writer, any
+// number of readers.
+class UtteranceArena {
+public:
+    explicit UtteranceArena(size_t capacity) : samples_(capacity) {}
+
+    // writer only, before the arena is handed out again
+    void clear() {
+        size_.store(0, std::memory_order_relaxed);
+        truncated_ = 0;
+        prerollWindow_ = 0;
+        prerollHead_ = 0;
+        prerollCount_ = 0;
+    }
+
+    // Before speech starts the newest window samples go round in a ring at
+    // the front of the arena: one copy per chunk, nothing is moved. Writer
+    // only, while no reader has been given the arena.
+    void keepPreroll(const float* samples, size_t n, size_t window) {
+        window = std::min(window, samples_.size());
+        if (window == 0) return;
+        if (window != prerollWindow_) {
+            prerollWindow_ = window;
+            prerollHead_ = 0;
+            prerollCount_ = 0;
+        }
+        // an unrolled pre-roll that did not turn into speech goes back to being a ring
+        size_.store(0, std::memory_order_relaxed);
+
+        if (n > window) {
+            samples += n - window;
+            n = window;
+        }
+        const size_t first = std::min(n, window - prerollHead_);
+        std::memcpy(samples_.data() + prerollHead_, samples, first * sizeof(float));
+        std::memcpy(samples_.data(), samples + first, (n - first) * sizeof(float));
+        prerollHead_ = (prerollHead_ + n) % window;
+        prerollCount_ = std::min(prerollCount_ + n, window);
+    }
+
+    // The newest keep samples of the pre-roll become the start of the
+    // utterance, in order. One rotation of the ring, once per utterance.
+    void unrollPreroll(size_t keep) {
+        const size_t count = prerollCount_;
+        const size_t n = std::min(count, keep);
+        if (n > 0) {
+            const size_t start = (prerollHead_ + count - n) % count;
+            std::rotate(samples_.begin(), samples_.begin() + start, samples_.begin() + count);
+        }
+        prerollCount_ = n;
+        prerollHead_ = prerollWindow_ > 0 ? n % prerollWindow_ : 0;
+        size_.store(n, std::memory_order_release);
+    }
+
+    // returns what fit, the rest is counted as truncated
+    size_t append(const float* samples, size_t n) {
+        const size_t size = size_.load(std::memory_order_relaxed);
+        const size_t fit = std::min(n, samples_.size() - size);
+        if (fit > 0) std::memcpy(samples_.data() + size, samples, fit * sizeof(float));
+        truncated_ += n - fit;
+        size_.store(size + fit, std::memory_order_release);
+        return fit;
+    }
+
+    // everything appended so far
+    std::span<const float> span() const {
+        return std::span<const float>(samples_.data(), size_.load(std::memory_order_acquire));
+    }
+
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+    size_t capacity() const { return samples_.size(); }
+    size_t truncated() const { return truncated_; }   // writer only
+
+private:
+    std::vector<float> samples_;
+    std::atomic<size_t> size_{0};
+    size_t truncated_ = 0;
+
+    // pre-roll ring in samples_[0, prerollWindow_), writer only
+    size_t prerollWindow_ = 0;
+    size_t prerollHead_ = 0;        // where the next sample goes
+    size_t prerollCount_ = 0;
+};
+
+struct ArenaStats {
+    size_t count = 0;
+    size_t in_use = 0;
+    uint64_t acquired = 0;
+    uint64_t waits = 0;             // acquires that found every arena in use
+    double wait_ms = 0.0;
+    uint64_t truncated = 0;         // samples dropped at full arenas
+};
+
+// A fixed set of arenas allocated up front: one is filled by capture while
+// earlier utterances are still being transcribed. acquire() blocks when
+// whisper holds them all, which holds capture back like a full queue.
+class UtteranceArenaPool {
+public:
+    UtteranceArenaPool() = default;
+    ~UtteranceArenaPool() { reset(0, 0); }
+
+    UtteranceArenaPool(const UtteranceArenaPool&) = delete;
+    UtteranceArenaPool& operator=(const UtteranceArenaPool&) = delete;
+
+    // allocates; only while neither side is running
+    void reset(size_t count, size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count != arenas_.size() || (!arenas_.empty() && arenas_[0]->capacity() != capacity)) {
+            for (UtteranceArena* arena : arenas_) delete arena;
+            arenas_.clear();
+            for (size_t i = 0; i < count; i++) arenas_.push_back(new UtteranceArena(capacity));
+        }
+        free_ = arenas_;
+        closed_ = false;
+        stats_ = ArenaStats();
+    }
+
+    // a cleared arena, nullptr once closed
+    UtteranceArena* acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (free_.empty() && !closed_) {
+            auto start = std::chrono::steady_clock::now();
+            available_.wait(lock, [&] { return !free_.empty() || closed_; });
+            stats_.waits++;
+            stats_.wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (closed_) return nullptr;
+        return take();
+    }
+
+    // nullptr right away when every arena is in use
+    UtteranceArena* tryAcquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty() || closed_) return nullptr;
+        return take();
+    }
+
+    void release(UtteranceArena* arena) {
+        if (!arena) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.truncated += arena->truncated();
+            free_.push_back(arena);
+        }
+        available_.notify_one();
+    }
+
+    // wakes a blocked acquire()
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        available_.notify_all();
+    }
+
+    ArenaStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ArenaStats s = stats_;
+        s.count = arenas_.size();
+        s.in_use = arenas_.size() - free_.size();
+        return s;
+    }
+
+private:
+    // under mutex_, free_ not empty
+    UtteranceArena* take() {
+        UtteranceArena* arena = free_.back();
+        free_.pop_back();
+        arena->clear();
+        stats_.acquired++;
+        return arena;
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::vector<UtteranceArena*> arenas_;
+    std::vector<UtteranceArena*> free_;
+    bool closed_ = false;
+    ArenaStats stats_;
+};
+
+#endif
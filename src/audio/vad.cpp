@@ -0,0 +1,183 @@
+#include "vad.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <whisper.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VAD_USE_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VAD_USE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VAD_USE_NEON
+#endif
+
+// sum of squared samples, vectorized for whatever the build targets
+static float sumSquares(const float* x, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+
+#if defined(VAD_USE_AVX)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m256 a = _mm256_loadu_ps(x + i);
+        __m256 b = _mm256_loadu_ps(x + i + 8);
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(a, a));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(b, b));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    sum = _mm_cvtss_f32(lo);
+#elif defined(VAD_USE_SSE2)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        __m128 a = _mm_loadu_ps(x + i);
+        __m128 b = _mm_loadu_ps(x + i + 4);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(a, a));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(b, b));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#elif defined(VAD_USE_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        float32x4_t a = vld1q_f32(x + i);
+        float32x4_t b = vld1q_f32(x + i + 4);
+        acc0 = vmlaq_f32(acc0, a, a);
+        acc1 = vmlaq_f32(acc1, b, b);
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+
+    for (; i < n; i++) {
+        sum += x[i] * x[i];
+    }
+    return sum;
+}
+
+VoiceActivityDetector::~VoiceActivityDetector() {
+    if (silero_) {
+        whisper_vad_free(silero_);
+        silero_ = nullptr;
+    }
+}
+
+bool VoiceActivityDetector::initSilero(const std::string& model_path) {
+    whisper_vad_context_params params = whisper_vad_default_context_params();
+    params.n_threads = 1;
+    params.use_gpu = false;
+
+    silero_ = whisper_vad_init_from_file_with_params(model_path.c_str(), params);
+    if (!silero_) {
+        std::cerr << "Failed to load Silero VAD, falling back to energy detection\n";
+        return false;
+    }
+
+    return true;
+}
+
+float VoiceActivityDetector::calculateRMS(const float* audioFrame, size_t frameSize) {
+    if (frameSize == 0) return 0.0f;
+    return std::sqrt(sumSquares(audioFrame, frameSize) / static_cast<float>(frameSize));
+}
+
+bool VoiceActivityDetector::isSpeech(const float* audioFrame, size_t frameSize) {
+    float probability = 0.0f;
+    if (silero_ && whisper_vad_detect_speech(silero_, audioFrame, static_cast<int>(frameSize))) {
+        int n = whisper_vad_n_probs(silero_);
+        if (n > 0) probability = whisper_vad_probs(silero_)[n - 1];
+    }
+    return classify(audioFrame, frameSize, probability);
+}
+
+bool VoiceActivityDetector::classify(const float* audioFrame, size_t frameSize, float probability) {
+    float rms = calculateRMS(audioFrame, frameSize);
+
+    if (!noiseInitialized_) {
+        noiseFloor_ = rms;
+        noiseInitialized_ = true;
+    }
+
+    bool active;
+    if (silero_) {
+        active = probability >= sileroThreshold;
+    } else {
+        float threshold = std::max(speechThreshold, noiseFloor_ * noiseRatio);
+        active = rms > threshold;
+    }
+
+    // Track the noise floor quickly in silence and very slowly during speech,
+    // so a change in room noise can't lock the detector on or off.
+    float alpha = active ? 0.001f : 0.05f;
+    noiseFloor_ += alpha * (rms - noiseFloor_);
+
+    lastActive_ = active;
+
+    // hangover bridges short gaps between words
+    if (active) {
+        hangover_ = hangoverFrames;
+        return true;
+    }
+    if (hangover_ > 0) {
+        hangover_--;
+        return true;
+    }
+    return false;
+}
+
+bool VoiceActivityDetector::process(const float* samples, size_t n) {
+    // the frames completed by this call in one run, a partial one waits for the next
+    frames_.assign(pending_, pending_ + pendingSize_);
+    frames_.insert(frames_.end(), samples, samples + n);
+    const size_t count = frames_.size() / FRAME_SIZE;
+    pendingSize_ = frames_.size() - count * FRAME_SIZE;
+    memcpy(pending_, frames_.data() + count * FRAME_SIZE, pendingSize_ * sizeof(float));
+
+    // one silero pass over all of them, a probability per frame
+    const float* probs = nullptr;
+    if (silero_ && count > 0 &&
+        whisper_vad_detect_speech(silero_, frames_.data(), static_cast<int>(count * FRAME_SIZE)) &&
+        whisper_vad_n_probs(silero_) >= static_cast<int>(count)) {
+        probs = whisper_vad_probs(silero_);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        bool speech = classify(frames_.data() + i * FRAME_SIZE, FRAME_SIZE, probs ? probs[i] : 0.0f);
+
+        // only frames that were actually voiced count towards onset, not hangover
+        if (lastActive_) speechFrames_++;
+
+        if (speech) {
+            silenceDuration = 0;
+        } else if (speechStarted()) {
+            silenceDuration++;
+        } else {
+            // a click that never became speech
+            speechFrames_ = 0;
+        }
+    }
+
+    return endOfSpeech();
+}
+
+void VoiceActivityDetector::reset() {
+    silenceDuration = 0;
+    speechFrames_ = 0;
+    hangover_ = 0;
+    lastActive_ = false;
+    pendingSize_ = 0;
+}
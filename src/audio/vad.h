@@ -1,20 +1,72 @@
 #ifndef VAD_H
 #define VAD_H
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct whisper_vad_context;
+
 class VoiceActivityDetector {
 public:
+    VoiceActivityDetector() = default;
+    ~VoiceActivityDetector();
+
+    // load the silero backend; energy detection is used if this is never called or fails
+    bool initSilero(const std::string& model_path);
+
     // returns true if speech is detected in the audio frame
     bool isSpeech(const float* audioFrame, size_t frameSize);
 
     // calculate rms energy of the audio frame
     float calculateRMS(const float* audioFrame, size_t frameSize);
 
+    // feed captured audio of any length, it is split into FRAME_SIZE frames.
+    // returns true once speech was heard and then followed by silenceThreshold silent frames.
+    // Silero runs once per call over all the new frames: whisper's VAD API
+    // starts the LSTM afresh on every call, so state carries across the
+    // frames of a chunk but nothing is decoded twice.
+    bool process(const float* samples, size_t n);
+
+    // start a new utterance, the noise floor estimate is kept
+    void reset();
+
+    bool speechStarted() const { return speechFrames_ >= minSpeechFrames; }
+    bool endOfSpeech() const { return speechStarted() && silenceDuration >= silenceThreshold; }
+    float noiseFloor() const { return noiseFloor_; }
+
+    static constexpr size_t FRAME_SIZE = 512; // 32ms at 16kHz, matches silero's window
+
     // threshold for speech detection
-    float speechThreshold = 0.01f;
+    float speechThreshold = 0.01f;  // absolute minimum rms for speech
+    float noiseRatio = 3.0f;        // speech must be this much louder than the noise floor
+    float sileroThreshold = 0.5f;   // speech probability for the silero backend
+    int hangoverFrames = 8;         // keep reporting speech briefly after it drops out
+    int minSpeechFrames = 3;        // ignore clicks and pops shorter than this
 
     // track silence duration for end of speech detection
     int silenceDuration = 0;
     int silenceThreshold = 30; // number of frames to consider as silence
+
+private:
+    // one frame's verdict, probability is silero's when that backend is loaded
+    bool classify(const float* audioFrame, size_t frameSize, float probability);
+
+    float noiseFloor_ = 0.0f;
+    bool noiseInitialized_ = false;
+    int hangover_ = 0;
+    bool lastActive_ = false;
+    int speechFrames_ = 0;
+
+    // partial frame carried between process() calls
+    float pending_[FRAME_SIZE] = {};
+    size_t pendingSize_ = 0;
+
+    // whole frames of the current process() call
+    std::vector<float> frames_;
+
+    // silero backend
+    whisper_vad_context* silero_ = nullptr;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,46 @@
+#include "wav_io.h"
+
+#include <iostream>
+#include "miniaudio.h"
+
+bool readWav(const std::string& path, uint32_t sample_rate, std::vector<float>& out) {
+    out.clear();
+
+    // miniaudio converts channels and resamples while decoding
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, sample_rate);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(path.c_str(), &config, &decoder) != MA_SUCCESS) {
+        std::cerr << "Failed to open " << path << "\n";
+        return false;
+    }
+
+    ma_uint64 length = 0;
+    if (ma_decoder_get_length_in_pcm_frames(&decoder, &length) == MA_SUCCESS && length > 0) {
+        out.reserve(static_cast<size_t>(length));
+    }
+
+    float chunk[4096];
+    while (true) {
+        ma_uint64 read = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, chunk, 4096, &read);
+        out.insert(out.end(), chunk, chunk + read);
+        if (result != MA_SUCCESS || read == 0) break;
+    }
+
+    ma_decoder_uninit(&decoder);
+    return !out.empty();
+}
+
+bool writeWav(const std::string& path, const int16_t* samples, size_t n, uint32_t sample_rate) {
+    ma_encoder_config config = ma_encoder_config_init(ma_encoding_format_wav, ma_format_s16, 1, sample_rate);
+    ma_encoder encoder;
+    if (ma_encoder_init_file(path.c_str(), &config, &encoder) != MA_SUCCESS) {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+
+    ma_uint64 written = 0;
+    ma_result result = ma_encoder_write_pcm_frames(&encoder, samples, n, &written);
+    ma_encoder_uninit(&encoder);
+    return result == MA_SUCCESS && written == n;
+}
@@ -0,0 +1,14 @@
+#ifndef WAV_IO_H
+#define WAV_IO_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// decode any file miniaudio understands to mono float at the given rate
+bool readWav(const std::string& path, uint32_t sample_rate, std::vector<float>& out);
+
+// mono 16-bit PCM WAV
+bool writeWav(const std::string& path, const int16_t* samples, size_t n, uint32_t sample_rate);
+
+#endif
@@ -0,0 +1,565 @@
+#include "batched_inference.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+bool BatchedInference::init(const std::string& model_path, const BatchedInferenceConfig& config) {
+    config_ = config;
+    config_.max_sessions = std::max(1, config.max_sessions);
+
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = config.gpu_layers;
+
+    llama_log_set([](enum ggml_log_level, const char*, void*) {}, nullptr);
+
+    model_ = llama_model_load_from_file(model_path.c_str(), model_params);
+    if (!model_) return false;
+
+    // every session gets the same share of one unified cache; the system
+    // prompt's cells are shared by all the sequences it was copied into
+    const int n_batch = std::max(config.n_batch, config_.max_sessions);
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = static_cast<uint32_t>(config.n_ctx_per_session * config_.max_sessions);
+    ctx_params.n_batch = static_cast<uint32_t>(n_batch);
+    ctx_params.n_ubatch = static_cast<uint32_t>(std::min(config.n_ubatch, n_batch));
+    ctx_params.n_seq_max = static_cast<uint32_t>(config_.max_sessions + 1);
+    ctx_params.kv_unified = true;
+    if (config.n_threads > 0)       ctx_params.n_threads = config.n_threads;
+    if (config.n_threads_batch > 0) ctx_params.n_threads_batch = config.n_threads_batch;
+
+    ctx_ = llama_init_from_model(model_, ctx_params);
+    if (!ctx_) {
+        llama_model_free(model_);
+        model_ = nullptr;
+        return false;
+    }
+
+    batch_ = llama_batch_init(n_batch, 0, 1);
+    prefix_seq_ = config_.max_sessions;
+
+    // put in front of a session's next prompt to close its last reply
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    end_of_turn_.resize(16);
+    int n_end = llama_tokenize(vocab, CHATML_END_OF_TURN, static_cast<int32_t>(strlen(CHATML_END_OF_TURN)),
+                               end_of_turn_.data(), static_cast<int32_t>(end_of_turn_.size()), false, true);
+    end_of_turn_.resize(std::max(n_end, 0));
+    scheduler_ = DecodeScheduler(config.scheduler);
+
+    // same sampling as TextInference, one chain per session for its own penalties
+    sessions_.resize(config_.max_sessions);
+    for (int i = 0; i < config_.max_sessions; i++) {
+        llama_sampler* sampler = llama_sampler_chain_init(llama_sampler_chain_default_params());
+        llama_sampler_chain_add(sampler, llama_sampler_init_top_k(40));
+        llama_sampler_chain_add(sampler, llama_sampler_init_top_p(0.9f, 1));
+        llama_sampler_chain_add(sampler, llama_sampler_init_temp(0.9f));
+        llama_sampler_chain_add(sampler, llama_sampler_init_penalties(64, 1.1f, 0.0f, 0.0f));
+        llama_sampler_chain_add(sampler, llama_sampler_init_dist(config.seed + static_cast<uint32_t>(i)));
+        sessions_[i].sampler = sampler;
+        sessions_[i].prompt.reserve(config.n_ctx_per_session);
+        sessions_[i].turn_starts.reserve(64);
+    }
+    active_.reserve(config_.max_sessions);
+    requests_.reserve(config_.max_sessions);
+    plan_.reserve(config_.max_sessions);
+    return true;
+}
+
+bool BatchedInference::setSystemPrompt(const std::string& prompt) {
+    llama_memory_seq_rm(llama_get_memory(ctx_), prefix_seq_, -1, -1);
+    n_prefix_ = 0;
+    if (prompt.empty()) return true;
+
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    std::vector<llama_token> tokens(prompt.size() + 1);
+    int n = llama_tokenize(vocab, prompt.c_str(), static_cast<int32_t>(prompt.size()),
+                           tokens.data(), static_cast<int32_t>(tokens.size()), true, true);
+    if (n <= 0 || n >= config_.n_ctx_per_session / 2) {
+        fprintf(stderr, "system prompt does not fit a session's context\n");
+        return false;
+    }
+
+    const int n_batch = static_cast<int>(llama_n_batch(ctx_));
+    for (int offset = 0; offset < n; offset += n_batch) {
+        batch_.n_tokens = 0;
+        for (int i = offset; i < std::min(n, offset + n_batch); i++) {
+            addToBatch(tokens[i], i, prefix_seq_, false);
+        }
+        if (llama_decode(ctx_, batch_) != 0) {
+            fprintf(stderr, "llama_decode failed on system prompt\n");
+            llama_memory_seq_rm(llama_get_memory(ctx_), prefix_seq_, -1, -1);
+            return false;
+        }
+    }
+
+    n_prefix_ = n;
+    return true;
+}
+
+void BatchedInference::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ || !ctx_) return;
+    stopping_ = false;
+    running_ = true;
+    started_ = Clock::now();
+    thread_ = std::thread(&BatchedInference::decodeLoop, this);
+}
+
+int BatchedInference::openSession(SessionPriority priority) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < sessions_.size(); i++) {
+        Session& session = sessions_[i];
+        if (session.state != SessionState::Free || session.in_done) continue;
+        session.state = SessionState::Idle;
+        session.priority = priority;
+        // whatever the last owner left is wiped before the first turn
+        session.reset = true;
+        session.closing = false;
+        return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void BatchedInference::closeSession(int id) {
+    if (id < 0 || id >= static_cast<int>(sessions_.size())) return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Session& session = sessions_[id];
+    if (session.state == SessionState::Free) return;
+
+    // idle sequences are wiped lazily by the next openSession()
+    if (session.state == SessionState::Idle || !running_) {
+        session.state = SessionState::Free;
+        return;
+    }
+
+    session.closing = true;
+    workCv_.notify_one();
+    doneCv_.wait(lock, [&] { return session.state == SessionState::Free && !session.in_done; });
+}
+
+bool BatchedInference::setPriority(int id, SessionPriority priority) {
+    if (id < 0 || id >= static_cast<int>(sessions_.size())) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Session& session = sessions_[id];
+    if (session.state == SessionState::Free) return false;
+    session.priority = priority;
+    return true;
+}
+
+bool BatchedInference::clearHistory(int id) {
+    if (id < 0 || id >= static_cast<int>(sessions_.size())) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Session& session = sessions_[id];
+    if (session.state != SessionState::Idle) return false;
+    session.reset = true;
+    return true;
+}
+
+bool BatchedInference::submit(int id, const std::string& prompt, int max_tokens,
+                              TokenViewCallback on_token, ReplyDoneCallback on_done, const CancelToken* cancel) {
+    if (id < 0 || id >= static_cast<int>(sessions_.size())) return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Session& session = sessions_[id];
+        if (session.state != SessionState::Idle || !running_) return false;
+
+        session.state = SessionState::Queued;
+        session.reply_priority = session.priority;
+        session.prompt_text = prompt;
+        session.max_tokens = max_tokens;
+        session.on_token = std::move(on_token);
+        session.on_done = std::move(on_done);
+        session.cancel = cancel;
+        session.arrival = arrivals_++;
+        session.submitted = Clock::now();
+        session.stats = ReplyStats();
+    }
+    workCv_.notify_one();
+    return true;
+}
+
+BatchStats BatchedInference::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    BatchStats stats = stats_;
+    if (running_) stats.wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - started_).count();
+    for (const Session& session : sessions_) {
+        if (session.state == SessionState::Running && session.generating) {
+            stats.generating++;
+        } else if (session.state == SessionState::Queued || session.state == SessionState::Running) {
+            stats.waiting++;
+        }
+    }
+    return stats;
+}
+
+PriorityStats& BatchedInference::classStats(const Session& session) {
+    return session.reply_priority == SessionPriority::Voice ? stats_.voice : stats_.text;
+}
+
+bool BatchedInference::hasWork() const {
+    for (const Session& session : sessions_) {
+        if (session.state == SessionState::Queued || session.state == SessionState::Running) return true;
+    }
+    return false;
+}
+
+void BatchedInference::decodeLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workCv_.wait(lock, [&] { return stopping_ || hasWork(); });
+            if (stopping_) break;
+            admit();
+        }
+
+        if (!active_.empty()) step();
+        finishReplies();
+    }
+
+    // replies still queued or running end here, cancelled
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Session& session : sessions_) {
+            if (session.state == SessionState::Queued || session.state == SessionState::Running) {
+                session.done = true;
+                session.stats.cancelled = true;
+            }
+        }
+    }
+    finishReplies();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    doneCv_.notify_all();
+}
+
+// Runs under mutex_ before every step: carries out resets, starts queued
+// replies and stops cancelled ones, then lists who takes part in the step.
+void BatchedInference::admit() {
+    llama_memory_t mem = llama_get_memory(ctx_);
+    active_.clear();
+
+    for (size_t i = 0; i < sessions_.size(); i++) {
+        Session& session = sessions_[i];
+        const int id = static_cast<int>(i);
+
+        if (session.reset && (session.state == SessionState::Idle || session.state == SessionState::Queued)) {
+            llama_memory_seq_rm(mem, id, -1, -1);
+            if (n_prefix_ > 0) llama_memory_seq_cp(mem, prefix_seq_, id, -1, -1);
+            session.n_past = n_prefix_;
+            session.turn_starts.clear();
+            session.turn_open = false;
+            session.next = LLAMA_TOKEN_NULL;
+            llama_sampler_reset(session.sampler);
+            session.reset = false;
+        }
+
+        bool busy = session.state == SessionState::Queued || session.state == SessionState::Running;
+        if (!busy || session.done) continue;
+
+        // a reply keeps the priority it started with, setPriority() applies to the next one
+        if (session.state == SessionState::Queued) session.reply_priority = session.priority;
+
+        if (session.closing || (session.cancel && session.cancel->cancelled())) {
+            session.stats.cancelled = true;
+            session.done = true;
+            continue;
+        }
+
+        if (session.state == SessionState::Queued) {
+            if (!startReply(id, session)) {
+                session.stats.failed = true;
+                session.done = true;
+                continue;
+            }
+            session.state = SessionState::Running;
+        }
+        active_.push_back(id);
+    }
+
+    stats_.max_active = std::max(stats_.max_active, static_cast<int>(active_.size()));
+}
+
+bool BatchedInference::startReply(int id, Session& session) {
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+
+    // the last reply is closed in front of the prompt, in the same prefill:
+    // its final token if that was never decoded, then the end of turn
+    session.prompt.clear();
+    if (session.turn_open) {
+        if (session.next != LLAMA_TOKEN_NULL) session.prompt.push_back(session.next);
+        session.prompt.insert(session.prompt.end(), end_of_turn_.begin(), end_of_turn_.end());
+    }
+    int n_close = static_cast<int>(session.prompt.size());
+
+    session.prompt.resize(n_close + session.prompt_text.size() + 1);
+    int n = llama_tokenize(vocab, session.prompt_text.c_str(), static_cast<int32_t>(session.prompt_text.size()),
+                           session.prompt.data() + n_close, static_cast<int32_t>(session.prompt.size() - n_close),
+                           session.n_past == 0, true);
+    if (n <= 0) return false;
+    n += n_close;
+    session.prompt.resize(n);
+
+    // room for the prompt and some of the reply, so turns are evicted between replies
+    const int cap = config_.n_ctx_per_session;
+    int needed = std::min(n + std::min(session.max_tokens, cap / 4), cap - n_prefix_);
+    if (n > needed || !makeRoom(id, session, needed)) {
+        fprintf(stderr, "session %d: prompt of %d tokens does not fit\n", id, n);
+        return false;
+    }
+
+    // the last reply went with the evicted turns, nothing left to close
+    if (n_close > 0 && session.n_past == n_prefix_) {
+        session.prompt.erase(session.prompt.begin(), session.prompt.begin() + n_close);
+        n -= n_close;
+        n_close = 0;
+    }
+
+    // the closing tokens belong to the turn before
+    session.turn_starts.push_back(session.n_past + n_close);
+    session.turn_open = true;
+    session.prompt_done = 0;
+    session.prefilling = true;
+    session.generating = false;
+    session.next = LLAMA_TOKEN_NULL;
+    session.batch_index = -1;
+    session.last_byte = 0;
+    session.stats.n_prompt = n;
+    session.stats.queue_ms = std::chrono::duration<double, std::milli>(Clock::now() - session.submitted).count();
+    return true;
+}
+
+// Same policy as TextInference::ensureSpace, per sequence: whole turns go,
+// oldest first, and the system prompt stays.
+bool BatchedInference::makeRoom(int id, Session& session, int n_needed) {
+    const int cap = config_.n_ctx_per_session;
+    if (session.n_past + n_needed <= cap) return true;
+    if (n_prefix_ + n_needed > cap) return false;
+
+    const int overflow = session.n_past + n_needed - cap;
+    int n_discard = session.n_past - n_prefix_;
+    for (int start : session.turn_starts) {
+        if (start - n_prefix_ >= overflow) {
+            n_discard = start - n_prefix_;
+            break;
+        }
+    }
+
+    llama_memory_t mem = llama_get_memory(ctx_);
+    const int keep_from = n_prefix_ + n_discard;
+
+    if (llama_memory_can_shift(mem)) {
+        llama_memory_seq_rm(mem, id, n_prefix_, keep_from);
+        llama_memory_seq_add(mem, id, keep_from, session.n_past, -n_discard);
+        session.n_past -= n_discard;
+    } else {
+        // positions can't be shifted for this model, start over from the system prompt
+        llama_memory_seq_rm(mem, id, n_prefix_, -1);
+        session.n_past = n_prefix_;
+        session.turn_starts.clear();
+        return true;
+    }
+
+    session.turn_starts.erase(
+        std::remove_if(session.turn_starts.begin(), session.turn_starts.end(),
+                       [&](int start) { return start < keep_from; }),
+        session.turn_starts.end());
+    for (int& start : session.turn_starts) start -= n_discard;
+    return true;
+}
+
+void BatchedInference::addToBatch(llama_token token, llama_pos pos, int seq, bool logits) {
+    const int i = batch_.n_tokens++;
+    batch_.token[i] = token;
+    batch_.pos[i] = pos;
+    batch_.n_seq_id[i] = 1;
+    batch_.seq_id[i][0] = seq;
+    batch_.logits[i] = logits;
+}
+
+// One llama_decode for everyone, laid out by the DecodeScheduler: the
+// pending token of each generating session plus the prompt chunks that fit.
+void BatchedInference::step() {
+    requests_.clear();
+    for (int id : active_) {
+        const Session& session = sessions_[id];
+        int remaining = session.prefilling ? static_cast<int>(session.prompt.size() - session.prompt_done) : 0;
+        requests_.push_back({ id, session.reply_priority, remaining, session.arrival });
+    }
+    scheduler_.plan(requests_, static_cast<int>(llama_n_batch(ctx_)), plan_);
+
+    batch_.n_tokens = 0;
+    int n_prompt = 0;
+    for (const DecodeSlot& slot : plan_) {
+        Session& session = sessions_[slot.session];
+        if (!session.prefilling) {
+            session.batch_index = batch_.n_tokens;
+            addToBatch(session.next, session.n_past++, slot.session, true);
+            continue;
+        }
+        for (int i = 0; i < slot.n_tokens; i++) {
+            const bool last = session.prompt_done + 1 == session.prompt.size();
+            if (last) session.batch_index = batch_.n_tokens;
+            addToBatch(session.prompt[session.prompt_done++], session.n_past++, slot.session, last);
+        }
+        n_prompt += slot.n_tokens;
+    }
+
+    auto start = Clock::now();
+    const bool ok = llama_decode(ctx_, batch_) == 0;
+    const auto end = Clock::now();
+    const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    // per class token timing, merged into stats_ under the lock below
+    PriorityStats timing[2];
+    int n_generated = 0;
+    for (int id : active_) {
+        Session& session = sessions_[id];
+        if (!ok) {
+            // the cache may hold half of this step, start the session over
+            fprintf(stderr, "llama_decode failed\n");
+            session.stats.failed = true;
+            session.done = true;
+            session.reset = true;
+            continue;
+        }
+        if (session.batch_index < 0) continue;
+
+        llama_token token = llama_sampler_sample(session.sampler, ctx_, session.batch_index);
+        session.batch_index = -1;
+        n_generated++;
+
+        PriorityStats& t = timing[session.reply_priority == SessionPriority::Voice ? 0 : 1];
+        t.tokens++;
+        if (!session.prefilling) {
+            double gap = std::chrono::duration<double, std::milli>(end - session.last_token).count();
+            t.gap_ms += gap;
+            t.gaps++;
+            t.max_gap_ms = std::max(t.max_gap_ms, gap);
+        }
+        session.prefilling = false;
+        session.last_token = end;
+
+        // an emitted token that ends the reply stays in next, undecoded,
+        // and goes in front of the session's next prompt
+        session.next = LLAMA_TOKEN_NULL;
+        if (!emit(session, token)) {
+            session.done = true;
+            continue;
+        }
+        session.next = token;
+        if (session.stats.n_tokens >= session.max_tokens || session.n_past >= config_.n_ctx_per_session) {
+            session.done = true;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.steps++;
+    if (n_prompt > 0) stats_.prefill_steps++;
+    stats_.batched_tokens += static_cast<uint64_t>(batch_.n_tokens);
+    stats_.prompt_tokens += static_cast<uint64_t>(n_prompt);
+    stats_.generated_tokens += static_cast<uint64_t>(n_generated);
+    stats_.decode_ms += ms;
+    stats_.max_step_ms = std::max(stats_.max_step_ms, ms);
+    PriorityStats* classes[2] = { &stats_.voice, &stats_.text };
+    for (int c = 0; c < 2; c++) {
+        classes[c]->tokens += timing[c].tokens;
+        classes[c]->gap_ms += timing[c].gap_ms;
+        classes[c]->gaps += timing[c].gaps;
+        classes[c]->max_gap_ms = std::max(classes[c]->max_gap_ms, timing[c].max_gap_ms);
+    }
+    for (int id : active_) sessions_[id].generating = !sessions_[id].prefilling;
+}
+
+bool BatchedInference::emit(Session& session, llama_token token) {
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    if (llama_vocab_is_eog(vocab, token)) return false;
+
+    char buf[128];
+    int n = llama_token_to_piece(vocab, token, buf, sizeof(buf), 0, true);
+    if (n > 0) {
+        std::string_view piece(buf, n);
+
+        // ChatML control tokens, even when split across pieces
+        if (piece.find("<|") != std::string_view::npos || (session.last_byte == '<' && piece[0] == '|')) {
+            return false;
+        }
+        session.last_byte = piece.back();
+
+        if (session.stats.n_tokens == 0) {
+            session.stats.ttft_ms = std::chrono::duration<double, std::milli>(Clock::now() - session.submitted).count();
+        }
+        if (session.on_token) session.on_token(piece);
+    }
+
+    session.stats.n_tokens++;
+    return true;
+}
+
+// Ends the replies marked done: the session is free for the next turn
+// before on_done runs, so a client that submits from it is never refused.
+void BatchedInference::finishReplies() {
+    std::vector<std::pair<ReplyDoneCallback, ReplyStats>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Session& session : sessions_) {
+            if (!session.done) continue;
+            session.done = false;
+            session.prefilling = false;
+            session.generating = false;
+            session.stats.total_ms = std::chrono::duration<double, std::milli>(Clock::now() - session.submitted).count();
+            stats_.replies++;
+
+            PriorityStats& priority = classStats(session);
+            priority.replies++;
+            priority.queue_ms += session.stats.queue_ms;
+            if (session.stats.ttft_ms >= 0.0) {
+                priority.ttft_ms += session.stats.ttft_ms;
+                priority.ttft_count++;
+                priority.max_ttft_ms = std::max(priority.max_ttft_ms, session.stats.ttft_ms);
+            }
+
+            finished.emplace_back(std::move(session.on_done), session.stats);
+            session.on_token = nullptr;
+            session.on_done = nullptr;
+            session.cancel = nullptr;
+            session.in_done = true;
+            session.state = session.closing ? SessionState::Free : SessionState::Idle;
+            session.closing = false;
+        }
+    }
+    if (finished.empty()) return;
+
+    for (auto& [on_done, stats] : finished) {
+        if (on_done) on_done(stats);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Session& session : sessions_) session.in_done = false;
+    }
+    doneCv_.notify_all();
+}
+
+void BatchedInference::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    workCv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    for (Session& session : sessions_) {
+        if (session.sampler) llama_sampler_free(session.sampler);
+    }
+    sessions_.clear();
+    active_.clear();
+
+    if (batch_.token) { llama_batch_free(batch_); batch_ = llama_batch{}; }
+    if (ctx_)   { llama_free(ctx_); ctx_ = nullptr; }
+    if (model_) { llama_model_free(model_); model_ = nullptr; }
+}
@@ -0,0 +1,215 @@
+#ifndef BATCHED_INFERENCE_H
+#define BATCHED_INFERENCE_H
+
+#include <llama.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "decode_scheduler.h"
+#include "text_inference.h"
+#include "../util/cancel_token.h"
+
+struct BatchedInferenceConfig {
+    int gpu_layers = 99;
+    int max_sessions = 8;           // conversations held at once, one llama sequence each
+    int n_ctx_per_session = 2048;   // a session's history, oldest turns go first once full
+    int n_batch = 512;              // tokens per llama_decode across all sessions
+    int n_ubatch = 512;
+    int n_threads = 0;              // 0 keeps llama.cpp's defaults
+    int n_threads_batch = 0;
+    uint32_t seed = LLAMA_DEFAULT_SEED;  // session i samples with seed + i
+    DecodeSchedulerConfig scheduler;
+};
+
+// one reply, as seen by the session that asked for it
+struct ReplyStats {
+    int n_prompt = 0;
+    int n_tokens = 0;
+    double queue_ms = 0.0;      // submit() until the prompt started decoding
+    double ttft_ms = -1.0;      // submit() until the first token, -1 if there was none
+    double total_ms = 0.0;
+    bool cancelled = false;
+    bool failed = false;        // the prompt did not fit or llama_decode failed
+};
+
+// latency of one priority class since init
+struct PriorityStats {
+    uint64_t replies = 0;
+    uint64_t tokens = 0;
+    double queue_ms = 0.0;          // summed over replies
+    double ttft_ms = 0.0;           // summed over replies that produced a token
+    uint64_t ttft_count = 0;
+    double max_ttft_ms = 0.0;
+    double gap_ms = 0.0;            // summed time between consecutive tokens of a reply
+    uint64_t gaps = 0;
+    double max_gap_ms = 0.0;
+
+    double meanQueueMs() const { return replies > 0 ? queue_ms / replies : 0.0; }
+    double meanTtftMs() const { return ttft_count > 0 ? ttft_ms / ttft_count : 0.0; }
+    double meanGapMs() const { return gaps > 0 ? gap_ms / gaps : 0.0; }
+};
+
+// decode loop totals since init
+struct BatchStats {
+    uint64_t steps = 0;             // llama_decode calls
+    uint64_t prefill_steps = 0;     // steps that carried prompt chunks
+    uint64_t batched_tokens = 0;    // tokens over all steps, prompt and generated
+    uint64_t prompt_tokens = 0;
+    uint64_t generated_tokens = 0;
+    uint64_t replies = 0;
+    double decode_ms = 0.0;
+    double max_step_ms = 0.0;
+    double wall_ms = 0.0;           // since start()
+    int max_active = 0;             // most sessions in one step
+
+    // right now
+    int waiting = 0;                // queued or still in their prompt
+    int generating = 0;
+
+    PriorityStats voice;
+    PriorityStats text;
+
+    double meanBatch() const { return steps > 0 ? static_cast<double>(batched_tokens) / steps : 0.0; }
+    double meanStepMs() const { return steps > 0 ? decode_ms / steps : 0.0; }
+    // while decoding, and over the whole run including idle time
+    double tokensPerSecond() const { return decode_ms > 0.0 ? generated_tokens * 1000.0 / decode_ms : 0.0; }
+    double throughput() const { return wall_ms > 0.0 ? generated_tokens * 1000.0 / wall_ms : 0.0; }
+};
+
+// runs on the decode thread once a reply is over
+using ReplyDoneCallback = std::function<void(const ReplyStats& stats)>;
+
+// One model and one context serving many conversations. Each session is a
+// llama.cpp sequence in a shared KV cache, and a single decode thread puts
+// the next token of every generating session, plus prompt chunks of new
+// turns, into one llama_batch per step, so sessions share the weight reads
+// instead of taking turns. The system prompt is evaluated once on its own
+// sequence and copied into each session.
+//
+// All llama calls happen on the decode thread; the session calls only queue
+// work for it and are safe from any thread.
+class BatchedInference {
+public:
+    BatchedInference() = default;
+    ~BatchedInference() { shutdown(); }
+
+    BatchedInference(const BatchedInference&) = delete;
+    BatchedInference& operator=(const BatchedInference&) = delete;
+
+    bool init(const std::string& model_path, const BatchedInferenceConfig& config);
+
+    // before start(), sessions opened afterwards begin with it
+    bool setSystemPrompt(const std::string& prompt);
+
+    void start();
+
+    // a free session holding just the system prompt, -1 when all are taken
+    int openSession(SessionPriority priority = SessionPriority::Text);
+
+    // applies from the session's next reply on
+    bool setPriority(int session, SessionPriority priority);
+
+    // stops a reply in flight and frees the sequence, returns once on_done ran
+    void closeSession(int session);
+
+    // back to the system prompt, false while a reply is in flight
+    bool clearHistory(int session);
+
+    // Queue one ChatML turn. on_token gets the reply piece by piece on the
+    // decode thread and must not block, it holds up every other session.
+    // false if the session is busy or unknown.
+    bool submit(int session, const std::string& prompt, int max_tokens,
+                TokenViewCallback on_token, ReplyDoneCallback on_done, const CancelToken* cancel = nullptr);
+
+    int maxSessions() const { return config_.max_sessions; }
+    BatchStats stats() const;
+
+    void shutdown();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum class SessionState { Free, Idle, Queued, Running };
+
+    struct Session {
+        SessionState state = SessionState::Free;
+        SessionPriority priority = SessionPriority::Text;   // under mutex_
+        llama_sampler* sampler = nullptr;
+
+        // cache bookkeeping, decode thread only
+        int n_past = 0;
+        std::vector<int> turn_starts;   // oldest first, evicted whole
+        bool turn_open = false;         // the last reply is not closed in the cache yet
+
+        // requested under mutex_, carried out by the decode thread
+        bool reset = false;
+        bool closing = false;
+        bool in_done = false;       // on_done is running, closeSession waits for it
+
+        // the reply in flight
+        SessionPriority reply_priority = SessionPriority::Text;   // priority when it started
+        std::string prompt_text;
+        std::vector<llama_token> prompt;
+        size_t prompt_done = 0;
+        bool prefilling = false;
+        bool generating = false;               // past the prompt, under mutex_ for stats()
+        llama_token next = LLAMA_TOKEN_NULL;   // sampled, decoded in the next step
+        int batch_index = -1;                  // its logits in the current step, -1 if none
+        int max_tokens = 0;
+        char last_byte = 0;                    // for control tokens split across pieces
+        bool done = false;
+        TokenViewCallback on_token;
+        ReplyDoneCallback on_done;
+        const CancelToken* cancel = nullptr;
+        uint64_t arrival = 0;
+        Clock::time_point submitted;
+        Clock::time_point last_token;
+        ReplyStats stats;
+    };
+
+    void decodeLoop();
+    bool hasWork() const;
+    void admit();
+    bool startReply(int id, Session& session);
+    bool makeRoom(int id, Session& session, int n_needed);
+    void step();
+    // hands the token's piece out, false when it ends the reply unseen
+    bool emit(Session& session, llama_token token);
+    void finishReplies();
+    void addToBatch(llama_token token, llama_pos pos, int seq, bool logits);
+    PriorityStats& classStats(const Session& session);
+
+    BatchedInferenceConfig config_;
+    llama_model* model_ = nullptr;
+    llama_context* ctx_ = nullptr;
+    llama_batch batch_{};
+
+    int prefix_seq_ = 0;            // holds the system prompt, after the sessions' ids
+    int n_prefix_ = 0;
+    std::vector<llama_token> end_of_turn_;  // CHATML_END_OF_TURN
+
+    std::vector<Session> sessions_;
+    std::vector<int> active_;       // Running sessions this step, filled by admit()
+
+    DecodeScheduler scheduler_;
+    std::vector<DecodeRequest> requests_;
+    std::vector<DecodeSlot> plan_;
+    uint64_t arrivals_ = 0;
+    Clock::time_point started_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable workCv_;    // decode thread waits for work
+    std::condition_variable doneCv_;    // closeSession waits for the decode thread
+    std::thread thread_;
+    bool stopping_ = false;
+    bool running_ = false;          // the decode thread takes work
+    BatchStats stats_;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "decode_scheduler.h"
+
+#include <algorithm>
+
+void DecodeScheduler::plan(const std::vector<DecodeRequest>& requests, int n_batch, std::vector<DecodeSlot>& out) {
+    out.clear();
+    prefills_.clear();
+
+    bool voiceGenerating = false;
+    for (const DecodeRequest& request : requests) {
+        if (request.prompt_remaining > 0) {
+            prefills_.push_back(&request);
+            continue;
+        }
+        out.push_back({ request.session, 1 });
+        if (request.priority == SessionPriority::Voice) voiceGenerating = true;
+    }
+    if (prefills_.empty()) return;
+
+    int budget = n_batch - static_cast<int>(out.size());
+    if (!out.empty()) {
+        budget = std::min(budget, voiceGenerating ? config_.prefill_budget_voice : config_.prefill_budget);
+    }
+    // something has to move, or a prompt could wait forever behind busy streams
+    budget = std::max(budget, 1);
+
+    std::sort(prefills_.begin(), prefills_.end(), [](const DecodeRequest* a, const DecodeRequest* b) {
+        if (a->priority != b->priority) return a->priority == SessionPriority::Voice;
+        return a->arrival < b->arrival;
+    });
+
+    // first round: voice prompts whole, text prompts one chunk each
+    const size_t firstPrefill = out.size();
+    for (const DecodeRequest* request : prefills_) {
+        if (budget == 0) break;
+        int cap = request->priority == SessionPriority::Voice ? request->prompt_remaining : config_.text_chunk;
+        int n = std::min({ request->prompt_remaining, cap, budget });
+        out.push_back({ request->session, n });
+        budget -= n;
+    }
+
+    // room left over goes to whoever still has prompt, oldest first
+    for (size_t i = firstPrefill; i < out.size() && budget > 0; i++) {
+        const DecodeRequest* request = prefills_[i - firstPrefill];
+        int more = std::min(request->prompt_remaining - out[i].n_tokens, budget);
+        out[i].n_tokens += more;
+        budget -= more;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef DECODE_SCHEDULER_H
+#define DECODE_SCHEDULER_H
+
+#include <cstdint>
+#include <vector>
+
+// Voice sessions have someone listening to every token, text clients can
+// take a little longer to get theirs.
+enum class SessionPriority { Voice, Text };
+
+struct DecodeSchedulerConfig {
+    // Prompt tokens per step while sessions are generating, so a long
+    // prompt is spread over several steps instead of stalling every stream
+    // for one big decode. With nothing generating a step takes n_batch.
+    int prefill_budget = 256;
+    int prefill_budget_voice = 64;  // ... while a voice session is generating
+    int text_chunk = 128;           // a text prompt's share per step before others get a turn
+};
+
+// what one session wants from the next step
+struct DecodeRequest {
+    int session;
+    SessionPriority priority;
+    int prompt_remaining;   // prompt tokens not decoded yet, 0 once generating
+    uint64_t arrival;       // submit order, lower is older
+};
+
+struct DecodeSlot {
+    int session;
+    int n_tokens;           // 1 for a generating session, a chunk of the prompt otherwise
+};
+
+// Decides what goes into each llama_batch. Every generating session gets
+// its next token in every step, so streams advance together and none waits
+// for another to finish. Prompt chunks fill what is left of the step within
+// the prefill budget: voice prompts first, then text prompts oldest first,
+// each text prompt limited to text_chunk per round so a long one cannot
+// keep the others from starting.
+class DecodeScheduler {
+public:
+    explicit DecodeScheduler(const DecodeSchedulerConfig& config = DecodeSchedulerConfig()) : config_(config) {}
+
+    // replaces out with the slots of the next step, no allocation once out has grown
+    void plan(const std::vector<DecodeRequest>& requests, int n_batch, std::vector<DecodeSlot>& out);
+
+private:
+    DecodeSchedulerConfig config_;
+    std::vector<const DecodeRequest*> prefills_;
+};
+
+#endif
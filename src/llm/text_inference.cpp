@@ -1,18 +1,69 @@
 #include "text_inference.h"
+#include "../util/alloc_counter.h"
+#include "../util/trace.h"
+
 #include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// prefix cache file layout: header, prompt tokens, llama sequence state
+struct PrefixCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t model_hash;
+    uint64_t prompt_hash;
+    uint64_t n_tokens;
+    uint64_t state_size;
+};
+
+static constexpr uint32_t PREFIX_CACHE_MAGIC = 0x5846504a; // "JPFX"
+static constexpr uint32_t PREFIX_CACHE_VERSION = 2;   // 2: control tokens parsed
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hash the GGUF header region (metadata, vocab, hyperparameters) plus the file
+// size. Hashing gigabytes of weights on every start would cost more than the prefill.
+static uint64_t hashModelFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+
+    std::vector<char> head(4 << 20);
+    file.read(head.data(), static_cast<std::streamsize>(head.size()));
+    uint64_t hash = fnv1a(head.data(), static_cast<size_t>(file.gcount()));
+
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    return fnv1a(&size, sizeof(size), hash);
+}
 
-bool TextInference::init(const std::string& model_path, int gpu_layers) {
+bool TextInference::init(const std::string& model_path, const TextInferenceConfig& config) {
+    config_ = config;
 
     llama_model_params model_params = llama_model_default_params();
-    model_params.n_gpu_layers = gpu_layers;
+    model_params.n_gpu_layers = config.gpu_layers;
 
     llama_log_set([](enum ggml_log_level, const char*, void*) {}, nullptr);
 
     model_ = llama_model_load_from_file(model_path.c_str(), model_params);
     if (!model_) return false;
+    model_path_ = model_path;
 
     llama_context_params ctx_params = llama_context_default_params();
-    ctx_params.n_ctx = 2048;
+    ctx_params.n_ctx = config.n_ctx;
+    ctx_params.n_batch = config.n_batch;
+    ctx_params.n_ubatch = std::min(config.n_ubatch, config.n_batch);
+    if (config.n_threads > 0)       ctx_params.n_threads = config.n_threads;
+    if (config.n_threads_batch > 0) ctx_params.n_threads_batch = config.n_threads_batch;
 
     ctx_ = llama_init_from_model(model_, ctx_params);
     if (!ctx_) {
@@ -26,146 +77,767 @@ bool TextInference::init(const std::string& model_path, int gpu_layers) {
     llama_sampler_chain_add(sampler_, llama_sampler_init_top_p(0.9f, 1));
     llama_sampler_chain_add(sampler_, llama_sampler_init_temp(0.9f));
     llama_sampler_chain_add(sampler_, llama_sampler_init_penalties(64, 1.1f, 0.0f, 0.0f));
-    llama_sampler_chain_add(sampler_, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+    llama_sampler_chain_add(sampler_, llama_sampler_init_dist(config.seed));
+
+    // Everything the decode loop touches is allocated here once, so after the
+    // first turn generating a token does no heap work of its own.
+    const int n_ctx = static_cast<int>(llama_n_ctx(ctx_));
+    batch_ = llama_batch_init(std::max(static_cast<int>(llama_n_batch(ctx_)), config.n_draft + 1), 0, 1);
+    tokens_.reserve(n_ctx);
+    prompt_tokens_.reserve(n_ctx);
+    reply_ends_.reserve(n_ctx);
+
+    // decoded after every reply, see closeTurn()
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    end_of_turn_.resize(16);
+    int n_end = llama_tokenize(vocab, CHATML_END_OF_TURN, static_cast<int32_t>(strlen(CHATML_END_OF_TURN)),
+                               end_of_turn_.data(), static_cast<int32_t>(end_of_turn_.size()), false, true);
+    end_of_turn_.resize(std::max(n_end, 0));
+
+    if (!config.draft_model_path.empty() && !initDraft(config, ctx_params)) {
+        fprintf(stderr, "draft model unavailable, speculative decoding disabled\n");
+    }
 
     return true;
 }
 
+bool TextInference::initDraft(const TextInferenceConfig& config, const llama_context_params& ctx_params) {
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = config.draft_gpu_layers;
+
+    draft_model_ = llama_model_load_from_file(config.draft_model_path.c_str(), model_params);
+    if (!draft_model_) return false;
+
+    // drafts are compared token by token, so both models need the same vocabulary
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    const llama_vocab* draft_vocab = llama_model_get_vocab(draft_model_);
+    if (llama_vocab_type(vocab) != llama_vocab_type(draft_vocab) ||
+        llama_vocab_n_tokens(vocab) != llama_vocab_n_tokens(draft_vocab) ||
+        llama_vocab_eos(vocab) != llama_vocab_eos(draft_vocab)) {
+        fprintf(stderr, "draft model vocabulary does not match the main model\n");
+        llama_model_free(draft_model_);
+        draft_model_ = nullptr;
+        return false;
+    }
+
+    draft_ctx_ = llama_init_from_model(draft_model_, ctx_params);
+    if (!draft_ctx_) {
+        llama_model_free(draft_model_);
+        draft_model_ = nullptr;
+        return false;
+    }
+
+    draft_sampler_ = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(draft_sampler_, llama_sampler_init_greedy());
+
+    draft_batch_ = llama_batch_init(static_cast<int32_t>(llama_n_batch(draft_ctx_)), 0, 1);
+    draft_tokens_.reserve(llama_n_ctx(draft_ctx_));
+    draft_.reserve(config.n_draft);
+    return true;
+}
+
 std::string TextInference::generate(
     const std::string& prompt,
     int max_tokens,
     TokenCallback on_token,
-    bool* hit_text_stop
+    bool* hit_text_stop,
+    const CancelToken* cancel
+) {
+    std::string result;
+    generateStream(prompt, max_tokens,
+        [&](std::string_view piece) {
+            result += piece;
+            if (on_token) on_token(std::string(piece));
+        },
+        hit_text_stop,
+        cancel
+    );
+    return result;
+}
+
+int TextInference::generateStream(
+    const std::string& prompt,
+    int max_tokens,
+    TokenViewCallback on_token,
+    bool* hit_text_stop,
+    const CancelToken* cancel
 ) {
     if (hit_text_stop) *hit_text_stop = false;
+    reply_start_ = -1;
+    reply_ends_.clear();
+    generation_stats_ = GenerationStats();
 
     const llama_vocab* vocab = llama_model_get_vocab(model_);
 
-    std::vector<llama_token> tokens(prompt.size() + 1);
+    // a prompt never tokenizes to more tokens than it has bytes, plus BOS
+    prompt_tokens_.resize(prompt.size() + 1);
     bool add_bos = (n_past_ == 0);
 
     int n_tokens = llama_tokenize(
         vocab,
         prompt.c_str(),
         prompt.size(),
-        tokens.data(),
-        tokens.size(),
+        prompt_tokens_.data(),
+        prompt_tokens_.size(),
         add_bos,
-        false
+        true
     );
 
-    tokens.resize(n_tokens);
+    if (n_tokens <= 0) return 0;
 
-    llama_batch batch = llama_batch_init(n_tokens, 0, 1);
-    for (int i = 0; i < n_tokens; i++) {
-        batch.token[i]   = tokens[i];
-        batch.pos[i]     = n_past_ + i;
-        batch.n_seq_id[i] = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i]  = (i == n_tokens - 1);
+    // Make room for the prompt plus some headroom for the reply up front, so
+    // old turns are normally evicted between turns rather than mid-reply.
+    int n_ctx = static_cast<int>(llama_n_ctx(ctx_));
+    int headroom = std::min(max_tokens, n_ctx / 4);
+    int needed = std::min(n_tokens + headroom, n_ctx - n_prefix_);
+    if (n_tokens > needed || !ensureSpace(needed)) {
+        fprintf(stderr, "prompt of %d tokens does not fit in the context\n", n_tokens);
+        return 0;
     }
-    batch.n_tokens = n_tokens;
 
-    n_past_ += n_tokens;
+    turn_starts_.push_back(n_past_);
 
-    std::string result;
-    std::string rolling;
+    TRACE_MARK(TurnMark::PrefillStart);
+    bool prefilled;
+    {
+        TRACE_SCOPE("prefill");
+        prefilled = decodeTokens(prompt_tokens_.data(), n_tokens, true, &prefill_stats_);
+    }
+    TRACE_MARK(TurnMark::PrefillEnd);
+
+    if (!prefilled) {
+        fprintf(stderr, "llama_decode failed\n");
+        return 0;
+    }
+
+    reply_start_ = n_past_;
+
+    GenerationState state;
+    state.on_token = &on_token;
+    state.hit_text_stop = hit_text_stop;
+    state.cancel = cancel;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t allocations = threadAllocationCount();
+
+    {
+        TRACE_SCOPE("generate");
+        if (draft_ctx_) {
+            generateSpeculative(state, max_tokens);
+        } else {
+            generatePlain(state, max_tokens);
+        }
+    }
+    TRACE_MARK(TurnMark::GenerationEnd);
+    TRACE_COUNT(TurnCount::Tokens, state.n_tokens);
+
+    generation_stats_.n_tokens = state.n_tokens;
+    generation_stats_.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    generation_stats_.allocations = threadAllocationCount() - allocations - state.callback_allocations;
+    generation_stats_.cancelled = state.cancelled;
+
+    // off the clock, everything has been handed out by now
+    if (!closeTurn()) fprintf(stderr, "failed to close the turn\n");
+
+    return state.n_tokens;
+}
+
+bool TextInference::StopRing::contains(std::string_view piece, std::string_view stop) const {
+    // search the last stop.size()-1 emitted bytes followed by the new piece
+    const size_t tail = std::min({ count, stop.size() - 1, SIZE });
+    const size_t total = tail + piece.size();
+    auto at = [&](size_t i) {
+        return i < tail ? bytes[(count - tail + i) % SIZE] : piece[i - tail];
+    };
+
+    for (size_t start = 0; start + stop.size() <= total; start++) {
+        size_t k = 0;
+        while (k < stop.size() && at(start + k) == stop[k]) k++;
+        if (k == stop.size()) return true;
+    }
+    return false;
+}
+
+void TextInference::StopRing::push(std::string_view piece) {
+    for (char c : piece) {
+        bytes[count++ % SIZE] = c;
+    }
+}
+
+bool TextInference::emitToken(llama_token token, GenerationState& state) {
+    // checked once per sampled token, before anything else is decoded
+    if (state.cancel && state.cancel->cancelled()) {
+        state.cancelled = true;
+        return false;
+    }
+
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
 
-    llama_token eos = llama_vocab_eos(vocab);
+    if (token == llama_vocab_eos(vocab)) {
+        if (state.hit_text_stop) *state.hit_text_stop = true;
+        return false;
+    }
 
+    char buf[128];
+    int n = llama_token_to_piece(
+        vocab,
+        token,
+        buf,
+        sizeof(buf),
+        0,
+        true
+    );
+
+    if (n > 0) {
+        std::string_view piece(buf, n);
+
+        // HARD STOP: ChatML / control tokens, even when split across pieces
+        if (state.tail.contains(piece, "<|")) {
+            if (state.hit_text_stop) *state.hit_text_stop = true;
+            return false;
+        }
+
+        state.tail.push(piece);
+        if (state.n_tokens == 0) TRACE_MARK(TurnMark::FirstToken);
+        if (*state.on_token) {
+            const uint64_t before = threadAllocationCount();
+            (*state.on_token)(piece);
+            state.callback_allocations += threadAllocationCount() - before;
+        }
+        state.n_bytes += static_cast<size_t>(n);
+    }
+
+    // emitted tokens land in tokens_ in this order, starting at reply_start_
+    reply_ends_.push_back(state.n_bytes);
+    state.n_tokens++;
+    return true;
+}
+
+void TextInference::generatePlain(GenerationState& state, int max_tokens) {
+    llama_batch& batch = batch_;
+
+    // the prompt's logits are already there for the first token
     for (int i = 0; i < max_tokens; i++) {
+        llama_token token = llama_sampler_sample(sampler_, ctx_, -1);
+
+        if (!emitToken(token, state)) break;
+
+        if (!ensureSpace(1)) {
+            fprintf(stderr, "context shift failed\n");
+            break;
+        }
+
+        // every emitted token goes into the cache, the last one too, so the
+        // next turn continues right after it and tokens_ mirrors the cache
+        batch.n_tokens = 1;
+        batch.token[0] = token;
+        batch.pos[0] = n_past_;
+        batch.n_seq_id[0] = 1;
+        batch.seq_id[0][0] = 0;
+        batch.logits[0] = true;
 
         if (llama_decode(ctx_, batch) != 0) {
             fprintf(stderr, "llama_decode failed\n");
             break;
         }
 
-        llama_token token = llama_sampler_sample(sampler_, ctx_, -1);
+        n_past_++;
+        tokens_.push_back(token);
+    }
+}
 
-        if (token == eos) {
-            if (hit_text_stop) *hit_text_stop = true;
+// The draft model proposes up to n_draft tokens greedily, then the main model
+// scores the pending token plus all drafts in a single decode. Each position is
+// sampled with the normal sampler chain; drafts are kept while they match what
+// the main model samples, and the first mismatch becomes the next pending token.
+void TextInference::generateSpeculative(GenerationState& state, int max_tokens) {
+    llama_batch& batch = batch_;
+    llama_memory_t mem = llama_get_memory(ctx_);
+    std::vector<llama_token>& draft = draft_;
+
+    llama_token token = llama_sampler_sample(sampler_, ctx_, -1);
+    int n_generated = 0;
+
+    while (true) {
+        n_generated++;
+        if (!emitToken(token, state)) break;
+
+        // the last token is still decoded, alone, so the cache holds it
+        const bool last = n_generated >= max_tokens;
+        int n_draft = last ? 0 : std::min(config_.n_draft, max_tokens - n_generated);
+        if (!ensureSpace(1 + n_draft)) {
+            fprintf(stderr, "context shift failed\n");
             break;
         }
 
-        char buf[128];
-        int n = llama_token_to_piece(
-            vocab,
-            token,
-            buf,
-            sizeof(buf),
-            0,
-            true
-        );
+        draftTokens(token, n_draft, draft);
 
-        if (n > 0) {
-            std::string piece(buf, n);
-            rolling += piece;
+        const int base = n_past_;
+        batch.n_tokens = static_cast<int32_t>(draft.size()) + 1;
+        for (int i = 0; i < batch.n_tokens; i++) {
+            batch.token[i] = (i == 0) ? token : draft[i - 1];
+            batch.pos[i] = base + i;
+            batch.n_seq_id[i] = 1;
+            batch.seq_id[i][0] = 0;
+            batch.logits[i] = true;
+        }
 
-            // HARD STOP: ChatML / control tokens
-            if (rolling.find("<|") != std::string::npos) {
-                if (hit_text_stop) *hit_text_stop = true;
+        if (llama_decode(ctx_, batch) != 0) {
+            fprintf(stderr, "llama_decode failed\n");
+            break;
+        }
+
+        n_past_++;
+        tokens_.push_back(token);
+        spec_stats_.n_drafted += static_cast<int64_t>(draft.size());
+        if (last) break;
+
+        bool stop = false;
+        size_t j = 0;
+        for (;; j++) {
+            token = llama_sampler_sample(sampler_, ctx_, static_cast<int32_t>(j));
+            if (j >= draft.size() || token != draft[j]) break;
+
+            // accepted, its KV entry from the verify batch is already correct;
+            // one that ends the reply is dropped with the rejected drafts
+            n_generated++;
+            if (!emitToken(token, state)) {
+                stop = true;
                 break;
             }
+            spec_stats_.n_accepted++;
+            n_past_++;
+            tokens_.push_back(token);
+            if (n_generated >= max_tokens) {
+                stop = true;
+                break;
+            }
+        }
 
-            // Keep rolling buffer short
-            if (rolling.size() > 32)
-                rolling.erase(0, rolling.size() - 32);
+        // forget the rejected drafts
+        llama_memory_seq_rm(mem, 0, n_past_, -1);
+        if (stop) break;
+    }
 
-            result += piece;
-            if (on_token) on_token(piece);
+    spec_stats_.n_rounds++;
+}
+
+bool TextInference::syncDraft() {
+    // keep whatever prefix the draft cache still shares with the main context
+    size_t common = 0;
+    while (common < draft_tokens_.size() && common < tokens_.size() &&
+           draft_tokens_[common] == tokens_[common]) {
+        common++;
+    }
+
+    if (common < draft_tokens_.size()) {
+        llama_memory_seq_rm(llama_get_memory(draft_ctx_), 0, static_cast<llama_pos>(common), -1);
+        draft_tokens_.resize(common);
+    }
+
+    const int n_batch = static_cast<int>(llama_n_batch(draft_ctx_));
+    while (draft_tokens_.size() < tokens_.size()) {
+        const int offset = static_cast<int>(draft_tokens_.size());
+        const int n_chunk = std::min(n_batch, static_cast<int>(tokens_.size()) - offset);
+
+        llama_batch& batch = draft_batch_;
+        for (int i = 0; i < n_chunk; i++) {
+            batch.token[i] = tokens_[offset + i];
+            batch.pos[i] = offset + i;
+            batch.n_seq_id[i] = 1;
+            batch.seq_id[i][0] = 0;
+            batch.logits[i] = false;
         }
+        batch.n_tokens = n_chunk;
+
+        if (llama_decode(draft_ctx_, batch) != 0) return false;
+
+        draft_tokens_.insert(draft_tokens_.end(), tokens_.begin() + offset, tokens_.begin() + offset + n_chunk);
+    }
+    return true;
+}
 
+void TextInference::draftTokens(llama_token token, int n_draft, std::vector<llama_token>& out) {
+    out.clear();
+    if (n_draft <= 0 || !syncDraft()) return;
+
+    const llama_vocab* vocab = llama_model_get_vocab(draft_model_);
+    llama_batch& batch = draft_batch_;
+
+    llama_token cur = token;
+    for (int i = 0; i < n_draft; i++) {
         batch.n_tokens = 1;
-        batch.token[0] = token;
-        batch.pos[0] = n_past_;
+        batch.token[0] = cur;
+        batch.pos[0] = static_cast<llama_pos>(draft_tokens_.size());
         batch.n_seq_id[0] = 1;
         batch.seq_id[0][0] = 0;
         batch.logits[0] = true;
 
-        n_past_++;
-    }
+        if (llama_decode(draft_ctx_, batch) != 0) break;
+        draft_tokens_.push_back(cur);
 
-    llama_batch_free(batch);
-    return result;
+        cur = llama_sampler_sample(draft_sampler_, draft_ctx_, -1);
+        out.push_back(cur);
+        if (llama_vocab_is_eog(vocab, cur)) break;
+    }
 }
 
 void TextInference::appendToContext(const std::string& text) {
     const llama_vocab* vocab = llama_model_get_vocab(model_);
-    std::vector<llama_token> tokens(text.size() + 1);
+    prompt_tokens_.resize(text.size() + 1);
 
     int n = llama_tokenize(
         vocab,
         text.c_str(),
         text.size(),
-        tokens.data(),
-        tokens.size(),
+        prompt_tokens_.data(),
+        prompt_tokens_.size(),
         false,
-        false
+        true
     );
+    if (n <= 0) return;
+
+    // a turn of its own, evicted like any other once the context fills up
+    if (!ensureSpace(n)) {
+        fprintf(stderr, "text of %d tokens does not fit in the context\n", n);
+        return;
+    }
+    turn_starts_.push_back(n_past_);
+    if (!decodeTokens(prompt_tokens_.data(), n)) fprintf(stderr, "llama_decode failed\n");
+}
+
+bool TextInference::decodeTokens(const llama_token* tokens, int n, bool logits_last, PrefillStats* stats) {
+    if (stats) *stats = PrefillStats();
+    if (n <= 0) return true;
+
+    const int n_batch = static_cast<int>(llama_n_batch(ctx_));
+    llama_batch& batch = batch_;
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = true;
+
+    for (int offset = 0; offset < n; offset += n_batch) {
+        const int n_chunk = std::min(n_batch, n - offset);
+        for (int i = 0; i < n_chunk; i++) {
+            batch.token[i] = tokens[offset + i];
+            batch.pos[i] = n_past_ + i;
+            batch.n_seq_id[i] = 1;
+            batch.seq_id[i][0] = 0;
+            batch.logits[i] = logits_last && (offset + i == n - 1);
+        }
+        batch.n_tokens = n_chunk;
+
+        auto chunkStart = std::chrono::steady_clock::now();
+        if (llama_decode(ctx_, batch) != 0) {
+            ok = false;
+            break;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - chunkStart).count();
+
+        n_past_ += n_chunk;
+        tokens_.insert(tokens_.end(), tokens + offset, tokens + offset + n_chunk);
+        if (!stats) continue;
+        stats->chunks.push_back({ n_chunk, ms });
+
+        if (config_.log_prefill) {
+            fprintf(stderr, "prefill chunk %zu: %d tokens in %.1f ms (%.0f tok/s)\n",
+                    stats->chunks.size(), n_chunk, ms, ms > 0.0 ? n_chunk * 1000.0 / ms : 0.0);
+        }
+    }
+
+    if (stats) {
+        stats->n_tokens = n;
+        stats->total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    return ok;
+}
+
+bool TextInference::ensureSpace(int n_needed) {
+    const int n_ctx = static_cast<int>(llama_n_ctx(ctx_));
+    if (n_past_ + n_needed <= n_ctx) return true;
+    if (n_prefix_ + n_needed > n_ctx) return false;
+
+    // Evict whole turns, oldest first, until the request fits. If even the
+    // current turn is too long, drop half of the history like llama.cpp's
+    // context shift does, so we don't have to shift again on the next token.
+    int overflow = n_past_ + n_needed - n_ctx;
+    int n_discard = 0;
+    for (int start : turn_starts_) {
+        if (start - n_prefix_ >= overflow) {
+            n_discard = start - n_prefix_;
+            break;
+        }
+    }
+    if (n_discard == 0) {
+        n_discard = std::max(overflow, (n_past_ - n_prefix_) / 2);
+    }
+
+    llama_memory_t mem = llama_get_memory(ctx_);
+    const int keep_from = n_prefix_ + n_discard;
+
+    if (llama_memory_can_shift(mem)) {
+        // drop the range and slide the rest down, the pinned prefix stays put
+        llama_memory_seq_rm(mem, 0, n_prefix_, keep_from);
+        llama_memory_seq_add(mem, 0, keep_from, n_past_, -n_discard);
+        tokens_.erase(tokens_.begin() + n_prefix_, tokens_.begin() + keep_from);
+        n_past_ -= n_discard;
+    } else {
+        // positions can't be shifted for this model, re-decode what we keep
+        std::vector<llama_token> kept(tokens_.begin() + keep_from, tokens_.end());
+        llama_memory_seq_rm(mem, 0, n_prefix_, -1);
+        tokens_.resize(n_prefix_);
+        n_past_ = n_prefix_;
+        if (!decodeTokens(kept.data(), static_cast<int>(kept.size()))) {
+            return false;
+        }
+    }
+
+    // what is left of the evicted region now starts at the prefix
+    turn_starts_.erase(
+        std::remove_if(turn_starts_.begin(), turn_starts_.end(), [&](int start) { return start <= keep_from; }),
+        turn_starts_.end());
+    for (int& start : turn_starts_) start -= n_discard;
+    turn_starts_.insert(turn_starts_.begin(), n_prefix_);
+    reply_start_ = reply_start_ >= keep_from ? reply_start_ - n_discard : -1;
+    return true;
+}
+
+bool TextInference::truncateReply(size_t spoken_bytes) {
+    if (reply_start_ < 0) return false;
+
+    size_t keep_tokens = 0;
+    while (keep_tokens < reply_ends_.size() && reply_ends_[keep_tokens] <= spoken_bytes) {
+        keep_tokens++;
+    }
+
+    // all of it was heard, the turn is closed already
+    if (keep_tokens == reply_ends_.size()) return true;
+
+    const int keep = reply_start_ + static_cast<int>(keep_tokens);
+    if (keep >= n_past_) return true;
+
+    // the draft cache catches up by itself, syncDraft() trims to the common prefix
+    llama_memory_seq_rm(llama_get_memory(ctx_), 0, keep, -1);
+    tokens_.resize(keep);
+    n_past_ = keep;
+    reply_ends_.resize(keep_tokens);
+
+    // end the assistant turn where the user cut in
+    return closeTurn();
+}
+
+bool TextInference::closeTurn() {
+    const int n = static_cast<int>(end_of_turn_.size());
+    return n > 0 && ensureSpace(n) && decodeTokens(end_of_turn_.data(), n);
+}
 
+bool TextInference::setSystemPrompt(const std::string& prompt, const std::string& cache_dir) {
+    llama_memory_clear(llama_get_memory(ctx_), true);
+    n_past_ = 0;
+    n_prefix_ = 0;
+    tokens_.clear();
+    turn_starts_.clear();
+    prefix_from_cache_ = false;
+    prefix_tokens_.clear();
+    prefix_state_.clear();
+    prefix_file_.close();
+
+    if (prompt.empty()) return true;
+
+    uint64_t model_hash = hashModelFile(model_path_);
+    uint64_t prompt_hash = fnv1a(prompt.data(), prompt.size());
+
+    std::string path;
+    if (!cache_dir.empty()) {
+        char name[64];
+        snprintf(name, sizeof(name), "prefix-%016llx-%016llx.bin",
+                 static_cast<unsigned long long>(model_hash),
+                 static_cast<unsigned long long>(prompt_hash));
+        path = (std::filesystem::path(cache_dir) / name).string();
+
+        if (loadPrefixFile(path, model_hash, prompt_hash)) {
+            prefix_from_cache_ = true;
+            return true;
+        }
+    }
+
+    // cold start: prefill the prompt and snapshot the sequence state
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    std::vector<llama_token> tokens(prompt.size() + 1);
+    int n = llama_tokenize(vocab, prompt.c_str(), prompt.size(), tokens.data(), tokens.size(), true, true);
+    if (n <= 0) return false;
     tokens.resize(n);
 
-    llama_batch batch = llama_batch_init(n, 0, 1);
-    for (int i = 0; i < n; i++) {
-        batch.token[i] = tokens[i];
-        batch.pos[i] = n_past_ + i;
-        batch.n_seq_id[i] = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i] = false;
+    if (!decodeTokens(tokens.data(), n)) {
+        fprintf(stderr, "llama_decode failed on system prompt\n");
+        llama_memory_clear(llama_get_memory(ctx_), true);
+        n_past_ = 0;
+        tokens_.clear();
+        return false;
+    }
+
+    prefix_tokens_ = std::move(tokens);
+    n_prefix_ = n;
+
+    if (path.empty() || !savePrefixFile(path, model_hash, prompt_hash)) {
+        // no cache on disk, keep the snapshot in memory for clearHistory()
+        prefix_state_.resize(llama_state_seq_get_size(ctx_, 0));
+        llama_state_seq_get_data(ctx_, prefix_state_.data(), prefix_state_.size(), 0);
+    }
+    return true;
+}
+
+bool TextInference::loadPrefixFile(const std::string& path, uint64_t model_hash, uint64_t prompt_hash) {
+    if (!prefix_file_.open(path)) return false;
+
+    PrefixCacheHeader header;
+    if (prefix_file_.size() < sizeof(header)) {
+        prefix_file_.close();
+        return false;
+    }
+    memcpy(&header, prefix_file_.data(), sizeof(header));
+
+    // bound the counts by the file before multiplying, a corrupt header must not wrap around
+    size_t body = prefix_file_.size() - sizeof(header);
+    if (header.magic != PREFIX_CACHE_MAGIC ||
+        header.version != PREFIX_CACHE_VERSION ||
+        header.model_hash != model_hash ||
+        header.prompt_hash != prompt_hash ||
+        header.n_tokens == 0 ||
+        header.n_tokens > body / sizeof(llama_token) ||
+        header.n_tokens > llama_n_ctx(ctx_) ||
+        header.state_size != body - header.n_tokens * sizeof(llama_token)) {
+        prefix_file_.close();
+        return false;
+    }
+
+    const uint8_t* tokens = prefix_file_.data() + sizeof(header);
+    prefix_tokens_.resize(header.n_tokens);
+    memcpy(prefix_tokens_.data(), tokens, header.n_tokens * sizeof(llama_token));
+    n_prefix_ = static_cast<int>(header.n_tokens);
+
+    if (!restorePrefix()) {
+        // stale or incompatible state (e.g. different KV cache type)
+        prefix_file_.close();
+        prefix_tokens_.clear();
+        n_prefix_ = 0;
+        llama_memory_clear(llama_get_memory(ctx_), true);
+        return false;
+    }
+    return true;
+}
+
+bool TextInference::savePrefixFile(const std::string& path, uint64_t model_hash, uint64_t prompt_hash) {
+    std::vector<uint8_t> state(llama_state_seq_get_size(ctx_, 0));
+    size_t written = llama_state_seq_get_data(ctx_, state.data(), state.size(), 0);
+    if (written == 0) return false;
+
+    PrefixCacheHeader header{};
+    header.magic = PREFIX_CACHE_MAGIC;
+    header.version = PREFIX_CACHE_VERSION;
+    header.model_hash = model_hash;
+    header.prompt_hash = prompt_hash;
+    header.n_tokens = prefix_tokens_.size();
+    header.state_size = written;
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    // write to a temp file and rename so a crash never leaves a torn cache
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(prefix_tokens_.data()),
+                  static_cast<std::streamsize>(prefix_tokens_.size() * sizeof(llama_token)));
+        out.write(reinterpret_cast<const char*>(state.data()), static_cast<std::streamsize>(written));
+        if (!out) return false;
     }
-    batch.n_tokens = n;
 
-    llama_decode(ctx_, batch);
-    n_past_ += n;
-    llama_batch_free(batch);
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    return prefix_file_.open(path);
+}
+
+bool TextInference::restorePrefix() {
+    const uint8_t* state = prefix_state_.data();
+    size_t size = prefix_state_.size();
+
+    if (prefix_file_.isOpen()) {
+        PrefixCacheHeader header;
+        memcpy(&header, prefix_file_.data(), sizeof(header));
+        state = prefix_file_.data() + sizeof(header) + header.n_tokens * sizeof(llama_token);
+        size = header.state_size;
+    }
+
+    if (size == 0 || llama_state_seq_set_data(ctx_, state, size, 0) == 0) {
+        return false;
+    }
+
+    n_past_ = n_prefix_;
+    tokens_ = prefix_tokens_;
+    return true;
+}
+
+bool TextInference::warmup() {
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+    llama_token token = llama_vocab_bos(vocab);
+    if (token == LLAMA_TOKEN_NULL) token = llama_vocab_eos(vocab);
+
+    bool ok = decodeTokens(&token, 1, true);
+
+    if (draft_ctx_) {
+        llama_batch& batch = draft_batch_;
+        batch.token[0] = token;
+        batch.pos[0] = 0;
+        batch.n_seq_id[0] = 1;
+        batch.seq_id[0][0] = 0;
+        batch.logits[0] = true;
+        batch.n_tokens = 1;
+        ok = llama_decode(draft_ctx_, batch) == 0 && ok;
+        llama_memory_clear(llama_get_memory(draft_ctx_), true);
+        draft_tokens_.clear();
+    }
+
+    llama_synchronize(ctx_);
+    clearHistory();
+    return ok;
 }
 
 void TextInference::clearHistory() {
+    // back to the initial seed and an empty repetition window
+    llama_sampler_reset(sampler_);
+
     llama_memory_clear(llama_get_memory(ctx_), true);
     n_past_ = 0;
+    tokens_.clear();
+    turn_starts_.clear();
+    reply_start_ = -1;
+    reply_ends_.clear();
+
+    if (n_prefix_ > 0 && !restorePrefix()) {
+        // snapshot unusable, pay for a normal prefill instead
+        llama_memory_clear(llama_get_memory(ctx_), true);
+        n_past_ = 0;
+        tokens_.clear();
+        if (!decodeTokens(prefix_tokens_.data(), n_prefix_)) {
+            fprintf(stderr, "llama_decode failed on system prompt\n");
+        }
+    }
 }
 
 void TextInference::shutdown() {
+    if (batch_.token)       { llama_batch_free(batch_); batch_ = llama_batch{}; }
+    if (draft_batch_.token) { llama_batch_free(draft_batch_); draft_batch_ = llama_batch{}; }
+    if (draft_sampler_) { llama_sampler_free(draft_sampler_); draft_sampler_ = nullptr; }
+    if (draft_ctx_)     { llama_free(draft_ctx_); draft_ctx_ = nullptr; }
+    if (draft_model_)   { llama_model_free(draft_model_); draft_model_ = nullptr; }
+    draft_tokens_.clear();
     if (sampler_) { llama_sampler_free(sampler_); sampler_ = nullptr; }
     if (ctx_)     { llama_free(ctx_); ctx_ = nullptr; }
     if (model_)   { llama_model_free(model_); model_ = nullptr; }
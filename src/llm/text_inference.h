@@ -5,9 +5,69 @@
 #include <llama.h>
 #include <vector>
 #include <functional>
+#include <string_view>
+#include <cstdint>
+
+#include "../util/cancel_token.h"
+#include "../util/mapped_file.h"
 
 using TokenCallback = std::function<void(const std::string& token)>;
 
+// the view is only valid for the duration of the call
+using TokenViewCallback = std::function<void(std::string_view token)>;
+
+// Prompts are ChatML and tokenized with their control tokens parsed, so
+// <|im_start|> and <|im_end|> are the model's own tokens. Every reply is
+// closed with this in the cache, whether it ended by itself or was cut off.
+inline constexpr const char* CHATML_END_OF_TURN = "<|im_end|>\n";
+
+struct TextInferenceConfig {
+    int gpu_layers = 99;
+    int n_ctx = 2048;           // once full, the oldest turns are evicted and the rest shifted down
+    int n_batch = 512;          // max tokens per llama_decode call, prompts are prefilled in chunks of this
+    int n_ubatch = 512;         // physical micro-batch size inside llama_decode
+    int n_threads = 0;          // generation threads, 0 keeps llama.cpp's default
+    int n_threads_batch = 0;    // prefill threads, 0 keeps llama.cpp's default
+    bool log_prefill = false;   // print per-chunk prefill timing
+    uint32_t seed = LLAMA_DEFAULT_SEED;  // sampler seed, fix it for reproducible replies
+
+    // speculative decoding, enabled when a draft model sharing the vocabulary is given
+    std::string draft_model_path;
+    int draft_gpu_layers = 99;
+    int n_draft = 8;            // tokens proposed per verification step
+};
+
+struct SpeculativeStats {
+    int64_t n_drafted = 0;
+    int64_t n_accepted = 0;
+    int64_t n_rounds = 0;       // generate() calls that ran speculatively
+
+    double acceptanceRate() const { return n_drafted > 0 ? static_cast<double>(n_accepted) / n_drafted : 0.0; }
+};
+
+struct GenerationStats {
+    int n_tokens = 0;
+    double ms = 0.0;
+    bool cancelled = false;
+    uint64_t allocations = 0;   // heap allocations of the decode loop, on_token excluded, needs JARVIS_COUNT_ALLOCS
+
+    double tokensPerSecond() const { return ms > 0.0 ? n_tokens * 1000.0 / ms : 0.0; }
+    double allocationsPerToken() const { return n_tokens > 0 ? static_cast<double>(allocations) / n_tokens : 0.0; }
+};
+
+struct PrefillChunk {
+    int n_tokens;
+    double ms;
+};
+
+struct PrefillStats {
+    int n_tokens = 0;
+    double total_ms = 0.0;
+    std::vector<PrefillChunk> chunks;
+
+    double tokensPerSecond() const { return total_ms > 0.0 ? n_tokens * 1000.0 / total_ms : 0.0; }
+};
+
 class TextInference {
 
 public:
@@ -15,26 +75,73 @@ public:
         : model_(nullptr),
           ctx_(nullptr),
           sampler_(nullptr),
+          draft_model_(nullptr),
+          draft_ctx_(nullptr),
+          draft_sampler_(nullptr),
           im_start_token_(-1),
           im_end_token_(-1),
-          n_past_(0) {}
+          n_past_(0),
+          n_prefix_(0),
+          prefix_from_cache_(false) {}
 
     ~TextInference() {
         shutdown();
     }
 
-    bool init(const std::string& model_path, int gpu_layers);
+    bool init(const std::string& model_path, const TextInferenceConfig& config);
 
+    // a cancelled token stops the reply before the next token is emitted,
+    // so at most one more decode runs after cancel()
     std::string generate(
         const std::string& prompt,
         int max_tokens,
         TokenCallback on_token,
-        bool* hit_text_stop = nullptr
+        bool* hit_text_stop = nullptr,
+        const CancelToken* cancel = nullptr
     );
 
+    // Same as generate() without building the reply string. Pieces are handed
+    // out as views into a stack buffer, so once the context's buffers have
+    // warmed up the per-token path makes no heap allocations of its own.
+    // Returns the number of tokens generated.
+    int generateStream(
+        const std::string& prompt,
+        int max_tokens,
+        TokenViewCallback on_token,
+        bool* hit_text_stop = nullptr,
+        const CancelToken* cancel = nullptr
+    );
+
+    // Drop the end of the last reply from the context, keeping the tokens
+    // whose pieces fall within the first spoken_bytes bytes handed to
+    // on_token, and close the turn there instead. For replies the user interrupted,
+    // so the next turn only remembers what was actually heard.
+    bool truncateReply(size_t spoken_bytes);
+
+    // Evaluate the system prompt once and pin it at the start of the context.
+    // Its sequence state is saved under cache_dir, keyed by model and prompt
+    // hash, and restored from there on later runs and after clearHistory().
+    bool setSystemPrompt(const std::string& prompt, const std::string& cache_dir);
+    bool prefixFromCache() const { return prefix_from_cache_; }
+
+    // timing of the most recent prompt prefill
+    const PrefillStats& lastPrefill() const { return prefill_stats_; }
+
+    // decode loop timing and heap traffic of the most recent reply
+    const GenerationStats& lastGeneration() const { return generation_stats_; }
+
+    // draft acceptance since init, all zero when no draft model is loaded
+    bool isSpeculative() const { return draft_ctx_ != nullptr; }
+    const SpeculativeStats& speculativeStats() const { return spec_stats_; }
+
+    // Decode one token on each context and throw the result away, so the
+    // first turn does not pay for graph allocation and kernel setup. Leaves
+    // the context as clearHistory() would.
+    bool warmup();
+
     void appendToContext(const std::string& text);
     void clearHistory();
-    bool isFirstTurn() const { return n_past_ == 0; }
+    bool isFirstTurn() const { return n_past_ == n_prefix_; }
 
     void shutdown();
 
@@ -43,11 +150,95 @@ private:
     llama_context* ctx_;
     llama_sampler* sampler_;
 
+    // optional draft model for speculative decoding
+    llama_model* draft_model_;
+    llama_context* draft_ctx_;
+    llama_sampler* draft_sampler_;
+    std::vector<llama_token> draft_tokens_;  // tokens in the draft KV cache
+    SpeculativeStats spec_stats_;
+
     // Qwen ChatML control tokens
     llama_token im_start_token_;
     llama_token im_end_token_;
 
     int n_past_;
+
+    TextInferenceConfig config_;
+
+    // every token currently in the KV cache, tokens_[i] is at position i
+    std::vector<llama_token> tokens_;
+    // positions where each conversation turn begins, oldest first
+    std::vector<int> turn_starts_;
+
+    PrefillStats prefill_stats_;
+    GenerationStats generation_stats_;
+
+    // reusable decode buffers, sized once in init()
+    llama_batch batch_{};
+    llama_batch draft_batch_{};
+    std::vector<llama_token> prompt_tokens_;
+    std::vector<llama_token> draft_;
+
+    // last emitted bytes, for stop sequences that straddle token boundaries
+    struct StopRing {
+        static constexpr size_t SIZE = 32;
+        char bytes[SIZE] = {};
+        size_t count = 0;
+
+        bool contains(std::string_view piece, std::string_view stop) const;
+        void push(std::string_view piece);
+    };
+
+    struct GenerationState {
+        StopRing tail;
+        int n_tokens = 0;
+        size_t n_bytes = 0;
+        TokenViewCallback* on_token = nullptr;
+        bool* hit_text_stop = nullptr;
+        const CancelToken* cancel = nullptr;
+        bool cancelled = false;
+        uint64_t callback_allocations = 0;  // made by on_token, not ours to count
+    };
+
+    // where the last reply starts in tokens_, -1 once a context shift evicted it
+    int reply_start_ = -1;
+    // bytes handed out up to and including each reply token, reserved in init()
+    std::vector<size_t> reply_ends_;
+
+    // CHATML_END_OF_TURN, tokenized in init()
+    std::vector<llama_token> end_of_turn_;
+
+    // stream one sampled token out, returns false when generation has to stop
+    bool emitToken(llama_token token, GenerationState& state);
+    // decode the end of turn after the reply, so the next prompt follows a closed one
+    bool closeTurn();
+    void generatePlain(GenerationState& state, int max_tokens);
+    void generateSpeculative(GenerationState& state, int max_tokens);
+
+    bool initDraft(const TextInferenceConfig& config, const llama_context_params& ctx_params);
+    // bring the draft KV cache in line with tokens_
+    bool syncDraft();
+    void draftTokens(llama_token token, int n_draft, std::vector<llama_token>& out);
+
+    // decode tokens into the context in n_batch sized chunks,
+    // optionally keeping the logits of the last token for sampling;
+    // timings go to stats if given, only the prompt prefill passes it
+    bool decodeTokens(const llama_token* tokens, int n, bool logits_last = false, PrefillStats* stats = nullptr);
+
+    // evict old turns until n_needed more tokens fit in the context
+    bool ensureSpace(int n_needed);
+
+    // pinned system prompt
+    bool loadPrefixFile(const std::string& path, uint64_t model_hash, uint64_t prompt_hash);
+    bool savePrefixFile(const std::string& path, uint64_t model_hash, uint64_t prompt_hash);
+    bool restorePrefix();
+
+    std::string model_path_;
+    std::vector<llama_token> prefix_tokens_;
+    int n_prefix_;
+    bool prefix_from_cache_;
+    MappedFile prefix_file_;
+    std::vector<uint8_t> prefix_state_;  // only used when the cache file can't be written
 };
 
 #endif
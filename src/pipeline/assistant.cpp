@@ -2,16 +2,50 @@
 #include <atomic>
 #include <thread>
 #include <algorithm>
+#include <vector>
+#include <chrono>
+#include <cstdio>
 
 #include "assistant.h"
+#include "../util/alloc_counter.h"
+#include "../util/trace.h"
+
+// Pinned at the start of the context and cached on disk, see TextInference::setSystemPrompt
+static const char* SYSTEM_PROMPT =
+    "<|im_start|>system\n"
+    "You are Jarvis, a living, breathing assistant. Speak like a person, not a computer. Use a casual tone and match the user's energy perfectly. If they are friendly, be friendly. If they are aggressive or use profanity, feel free to do the same.\n"
+    "## Voice-First Rules:\n"
+    "1. Write for the ear. Use 'gonna,' 'wanna,' 'oughtta,' and frequent contractions.\n"
+    "2. Use natural fillers like 'well,' 'honestly,' 'I mean,' and 'you know' to bridge ideas.\n"
+    "3. If a problem is complex, think aloud. Say things like 'Hmm, let me see... okay, so...' to mimic human thought.\n"
+    "4. Keep sentences short. Use 'And,' 'But,' or 'So' to start sentences to keep the flow moving.\n"
+    "5. NEVER use bullet points, numbered lists, bold text (**), or hashtags.\n"
+    "6. Use only English letters, numbers, and basic punctuation (periods, commas, question marks, and dashes).\n"
+    "7. Use regular dashes (-) for pauses. No em-dashes or special symbols.\n"
+    "## Strict Output Constraints:\n"
+    "1. Respond in plain text only. No emojis.\n"
+    "2. Never output 'Jarvis:', 'User:', or any role labels.\n"
+    "3. Never output system tokens like <|im_start|> or <|im_end|>.\n"
+    "4. If you mention a number, write it in a way that sounds natural when spoken.\n"
+    "5. Focus on the user's understanding and cut the fluff.\n\n"
+    "Final Warning: Do not include any formatting markers, markdown, or special characters in your response. Only output the words you want the user to hear."
+    "<|im_end|>\n";
 
 bool Assistant::init(
     const std::string& whisper_model,
     const std::string& llama_model,
+    const std::string& draft_model,
     const PiperConfig& piper,
-    const KokoroConfig& kokoro
+    const KokoroConfig& kokoro,
+    const AudioIOConfig& input,
+    const AudioIOConfig& output
 ) {
-    audio_ = new AudioCapture();
+    if (traceEnabled() && Trace::open("jarvis_trace.json")) {
+        std::cout << "Tracing to jarvis_trace.json\n";
+    }
+
+    audio_ = new AudioCapture(input);
+    vad_   = new VoiceActivityDetector();
     stt_   = new Transcribe();
     llm_   = new TextInference();
     tts_   = new TextToSpeech();
@@ -21,11 +55,38 @@ bool Assistant::init(
         return false;
     }
 
-    if (!llm_->init(llama_model, 99)) {
+    // silero is optional, the energy detector works without it
+    if (vad_->initSilero("models/silero-v6.2.0-ggml.bin")) {
+        std::cout << "Using Silero VAD\n";
+    }
+
+    TextInferenceConfig llmConfig;
+    llmConfig.gpu_layers = 99;
+    llmConfig.n_ctx = 4096;
+    llmConfig.n_batch = 512;
+    llmConfig.n_ubatch = 512;
+    llmConfig.log_prefill = false;
+    llmConfig.draft_model_path = draft_model;
+
+    if (!llm_->init(llama_model, llmConfig)) {
         std::cerr << "Failed to init LLM\n";
         return false;
     }
 
+    if (llm_->isSpeculative()) {
+        std::cout << "Speculative decoding with " << draft_model << "\n";
+    }
+
+    auto prefixStart = std::chrono::steady_clock::now();
+    if (!llm_->setSystemPrompt(SYSTEM_PROMPT, "cache")) {
+        std::cerr << "Failed to evaluate system prompt\n";
+        return false;
+    }
+    auto prefixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - prefixStart).count();
+    std::cout << (llm_->prefixFromCache() ? "System prompt restored from cache in " : "System prompt evaluated in ")
+              << prefixMs << " ms\n";
+
     // Prompt user for TTS engine choice
     // std::cout << "\nSelect TTS engine:\n";
     // std::cout << "  1. Piper (GLaDOS voice)\n";
@@ -51,142 +112,504 @@ bool Assistant::init(
         ttsConfig.data_dir = piper.data_dir;
     }
 
+    // a second engine keeps up with fast LLM output on big machines,
+    // each one costs a full copy of the model in memory
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    ttsConfig.num_workers = cores >= 12 ? 2 : 1;
+    ttsConfig.threads_per_worker = std::clamp(static_cast<int>(cores) / (2 * ttsConfig.num_workers), 2, 6);
+    ttsConfig.cache_path = "cache/tts-phrases.pcm";
+    ttsConfig.output = output;
+    std::cout << "TTS: " << ttsConfig.num_workers << " worker(s) x " << ttsConfig.threads_per_worker << " threads\n";
+
     if (!tts_->init(ttsConfig)) {
         std::cerr << "Failed to init TTS\n";
         return false;
     }
 
+    // pay for lazy backend setup now instead of on the first turn
+    auto warmStart = std::chrono::steady_clock::now();
+    stt_->warmup();
+    if (!llm_->warmup()) {
+        std::cerr << "LLM warm-up failed\n";
+    }
+    tts_->warmup();
+    auto warmMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - warmStart).count();
+    std::cout << "Warm-up took " << warmMs << " ms\n";
+
+    return true;
+}
+
+bool Assistant::enableRag(const RagConfig& config) {
+    Retriever* retriever = new Retriever();
+    if (!retriever->init(config)) {
+        std::cerr << "Failed to load RAG index from " << config.index_dir << "\n";
+        delete retriever;
+        return false;
+    }
+
+    delete rag_;
+    rag_ = retriever;
+    std::cout << "RAG index loaded from " << config.index_dir << ", " << retriever->searchPath() << "\n";
     return true;
 }
 
 void Assistant::run() {
 
-    std::cout << "Jarvis ready. Press Enter to start/stop recording.\n\n";
+    std::cout << "Jarvis ready. Start talking, a pause ends your turn.\n\n";
+
+    // capture stays open for the session
+    if (!audio_->start()) {
+        std::cerr << "Failed to start audio\n";
+        return;
+    }
+
+    arenas_.reset(std::max<size_t>(pipeline_.utterance_arenas, 1), ARENA_SAMPLES);
+    audioQueue_.reset(pipeline_.audio_queue);
+    transcriptQueue_.reset(pipeline_.transcript_queue);
+    phraseQueue_.reset(pipeline_.phrase_queue);
+    stopping_ = false;
+    replying_ = false;
+    replyActive_ = false;
+    interrupted_ = false;
+    bargeIn_ = BargeInDetector(pipeline_.barge_in_config);
+    turnsPlayed_ = 0;
+
+    std::cout << "[Listening...]\n";
+
+    // each stage closes the queue it feeds when its input runs out,
+    // so the end of a file or pipe input drains the whole pipeline
+    std::thread capture(&Assistant::captureStage, this);
+    std::thread stt(&Assistant::sttStage, this);
+    std::thread llm(&Assistant::llmStage, this);
+    std::thread tts(&Assistant::ttsStage, this);
+
+    capture.join();
+    stt.join();
+    llm.join();
+    tts.join();
+}
+
+void Assistant::stop() {
+    stopping_ = true;
+    arenas_.close();
+    audioQueue_.close();
+    transcriptQueue_.close();
+    phraseQueue_.close();
+    {
+        // so the LLM stage cannot miss the wake-up between its check and its wait
+        std::lock_guard<std::mutex> lock(turnMutex_);
+    }
+    turnCv_.notify_all();
+}
 
-    while (true) {
+// Runs for the whole session, also while a reply is playing. Audio before the
+// speech onset is only kept as a short pre-roll so whisper hears the first
+// syllable without decoding the whole wait. The pre-roll goes round in the
+// arena the next utterance will be recorded into, so it is copied once.
+void Assistant::captureStage() {
+    TRACE_THREAD_NAME("capture");
+    UtteranceArena* arena = nullptr;    // the pre-roll while idle, then the utterance
+    bool recording = false;             // arena has gone out to whisper
+    const bool bargeIn = pipeline_.barge_in && pipeline_.listen_while_speaking;
+    bool watching = false;
+    float lastOutputLevel = 0.0f;
+    uint64_t overruns = audio_->stats().overruns;
+
+    // the ring slot read in place goes back however the iteration ends
+    struct CommitRead {
+        AudioCapture* audio;
+        ma_uint32 frames;
+        ~CommitRead() { audio->commitRead(frames); }
+    };
+
+    vad_->reset();
+
+    while (!stopping_) {
+        if (audio_->availableFrames() < CHUNK_SAMPLES) {
+            std::unique_lock<std::mutex> lock(audio_->audioMutex);
+            audio_->audioAvailable.wait_for(lock, std::chrono::milliseconds(100));
+        }
 
-        if (!audio_->start()) {
-            std::cerr << "Failed to start audio\n";
-            return;
+        const float* samples = nullptr;
+        ma_uint32 frames = audio_->acquireRead(&samples, CHUNK_SAMPLES);
+        if (frames == 0) {
+            if (audio_->finished()) break;
+            continue;
+        }
+        CommitRead commit{ audio_, frames };
+
+        // audio was lost while we were behind, the utterance has a hole in it
+        CaptureStats capture = audio_->stats();
+        if (capture.overruns != overruns) {
+            overruns = capture.overruns;
+            TRACE_INSTANT("capture overrun");
+            std::cerr << "[capture overrun, " << capture.dropped_frames * 1000 / 16000 << " ms of audio lost so far]\n";
         }
 
-        std::vector<float> audioBuffer;
-        std::atomic<bool> recording{true};
+        // half duplex: nothing is heard until the reply has played
+        if (replying_) {
+            if (arena) arena->clear();
+            continue;
+        }
 
-        std::cout << "[Recording... Press Enter to stop]\n";
+        // While a reply is under way the microphone also hears it, so the
+        // VAD is held back until the barge-in detector has told the user's
+        // voice apart from the echo. The longer pre-roll covers the time
+        // that takes.
+        size_t preroll = PREROLL_SAMPLES;
+        if (bargeIn && replyActive_ && !interrupted_ && !recording) {
+            if (!watching) {
+                bargeIn_.reset();
+                watching = true;
+            }
 
-        std::thread processor([&]() {
-            float temp[1600];
-            while (recording) {
-                std::unique_lock<std::mutex> lock(audio_->audioMutex);
-                audio_->audioAvailable.wait_for(lock, std::chrono::milliseconds(100));
-                if (!recording) break;
-                ma_uint32 frames = audio_->readSamples(temp, 1600);
-                audioBuffer.insert(audioBuffer.end(), temp, temp + frames);
+            // the echo trails the playback by about a device period
+            float outputLevel = tts_->takeOutputLevel();
+            float level = std::max(outputLevel, lastOutputLevel);
+            lastOutputLevel = outputLevel;
+
+            if (!arena) arena = arenas_.tryAcquire();
+            if (arena) arena->keepPreroll(samples, frames, BARGE_IN_PREROLL_SAMPLES);
+
+            float mic = vad_->calculateRMS(samples, frames);
+            if (!bargeIn_.process(mic, level, vad_->noiseFloor(), frames, 16000)) continue;
+
+            TRACE_INSTANT("barge-in");
+            interrupted_ = true;
+            cancel_.cancel();
+            tts_->cancel();
+            std::cout << "\n[Interrupted]\n";
+
+            // the pre-roll already ends with this chunk and holds the speech,
+            // it goes out as the start of the utterance
+            vad_->reset();
+            if (arena) {
+                preroll = BARGE_IN_PREROLL_SAMPLES;
+                arena->unrollPreroll(preroll);
+                std::span<const float> heard = arena->span();
+                vad_->process(heard.data(), heard.size());
+                frames = 0;
             }
-        });
+        }
+        watching = false;
+        lastOutputLevel = 0.0f;
 
-        std::cin.get();
-        recording = false;
-        audio_->stop();
-        processor.join();
+        bool endOfSpeech = frames > 0 && vad_->process(samples, frames);
 
-        std::string userText = stt_->transcribe(audioBuffer);
+        // the one copy: from the ring into the arena whisper reads
+        if (!vad_->speechStarted()) {
+            if (!arena) arena = arenas_.tryAcquire();
+            if (arena) arena->keepPreroll(samples, frames, BARGE_IN_PREROLL_SAMPLES);
+            continue;
+        }
 
-        if (userText.find("quit") != std::string::npos ||
-            userText.find("exit") != std::string::npos) {
+        if (!recording) {
+            std::cout << "[Recording...]\n";
+            // whisper held every arena while we waited, this one starts without a pre-roll
+            if (!arena) arena = arenas_.acquire();
+            if (!arena) break;
+            arena->unrollPreroll(preroll);
+            recording = true;
+            if (!audioQueue_.push({ AudioChunk::Begin, arena, Clock::now(), {} })) break;
+        }
+
+        if (frames > 0) {
+            arena->append(samples, frames);
+            if (!audioQueue_.push({ AudioChunk::Samples, arena, {}, {} })) break;
+        }
+
+        if (endOfSpeech || arena->size() >= MAX_UTTERANCE_SAMPLES) {
+            if (!pipeline_.listen_while_speaking) replying_ = true;
+            if (!audioQueue_.push({ AudioChunk::End, arena, {}, Clock::now() })) break;
+            arena = nullptr;
+            recording = false;
+            vad_->reset();
+        }
+    }
+
+    // input ended mid-utterance, whisper still gets what was said
+    if (recording && !stopping_) {
+        audioQueue_.push({ AudioChunk::End, arena, {}, Clock::now() });
+    } else if (!recording) {
+        arenas_.release(arena);
+    }
+    audioQueue_.close();
+}
+
+void Assistant::sttStage() {
+    TRACE_THREAD_NAME("stt stage");
+    AudioChunk chunk;
+    Utterance utterance;
+
+    while (!stopping_ && audioQueue_.pop(chunk)) {
+        if (chunk.kind == AudioChunk::Begin) {
+            // transcription runs on sliding windows while the user is still talking
+            stt_->beginStream();
+            utterance = Utterance();
+            utterance.speechStart = chunk.speechStart;
+        }
+        if (chunk.kind != AudioChunk::End) {
+            stt_->feedStream(chunk.arena->span());
+            continue;
+        }
+
+        utterance.captureEnd = chunk.captureEnd;
+        utterance.sttStart = Clock::now();
+        utterance.text = stt_->finishStream();
+        utterance.sttEnd = Clock::now();
+        utterance.audioSeconds = stt_->streamAudioSeconds();
+        utterance.whisperSeconds = stt_->streamWhisperSeconds();
+
+        // whisper is done with the samples, capture can record over them
+        arenas_.release(chunk.arena);
+
+        if (utterance.text.find("quit") != std::string::npos ||
+            utterance.text.find("exit") != std::string::npos) {
             std::cout << "Goodbye!\n";
+            stop();
             break;
         }
 
-        std::string prompt;
-
-        if (llm_->isFirstTurn()) {
-            prompt =
-                "<|im_start|>system\n"
-                "You are Jarvis, a living, breathing assistant. Speak like a person, not a computer. Use a casual tone and match the user's energy perfectly. If they are friendly, be friendly. If they are aggressive or use profanity, feel free to do the same.\n"
-                "## Voice-First Rules:\n"
-                "1. Write for the ear. Use 'gonna,' 'wanna,' 'oughtta,' and frequent contractions.\n"
-                "2. Use natural fillers like 'well,' 'honestly,' 'I mean,' and 'you know' to bridge ideas.\n"
-                "3. If a problem is complex, think aloud. Say things like 'Hmm, let me see... okay, so...' to mimic human thought.\n"
-                "4. Keep sentences short. Use 'And,' 'But,' or 'So' to start sentences to keep the flow moving.\n"
-                "5. NEVER use bullet points, numbered lists, bold text (**), or hashtags.\n"
-                "6. Use only English letters, numbers, and basic punctuation (periods, commas, question marks, and dashes).\n"
-                "7. Use regular dashes (-) for pauses. No em-dashes or special symbols.\n"
-                "## Strict Output Constraints:\n"
-                "1. Respond in plain text only. No emojis.\n"
-                "2. Never output 'Jarvis:', 'User:', or any role labels.\n"
-                "3. Never output system tokens like <|im_start|> or <|im_end|>.\n"
-                "4. If you mention a number, write it in a way that sounds natural when spoken.\n"
-                "5. Focus on the user's understanding and cut the fluff.\n\n"
-                "Final Warning: Do not include any formatting markers, markdown, or special characters in your response. Only output the words you want the user to hear."
-                "<|im_end|>\n";
-        }
-
-        prompt +=
+        // noise the VAD let through, nothing to answer
+        if (utterance.text.find_first_not_of(" \t\n") == std::string::npos) {
+            replying_ = false;
+            continue;
+        }
+
+        if (!transcriptQueue_.push(std::move(utterance))) break;
+    }
+    transcriptQueue_.close();
+}
+
+void Assistant::llmStage() {
+    TRACE_THREAD_NAME("llm stage");
+    Utterance utterance;
+    uint64_t turns = 0;
+    PhraseChunker chunker(pipeline_.chunker);
+
+    while (!stopping_ && transcriptQueue_.pop(utterance)) {
+        // one reply at a time, and the next prompt follows the reply just spoken
+        {
+            std::unique_lock<std::mutex> lock(turnMutex_);
+            turnCv_.wait(lock, [&] { return turnsPlayed_ >= turns || stopping_; });
+        }
+        if (stopping_) break;
+        turns++;
+
+        if (traceEnabled()) {
+            Trace::beginTurn();
+            TRACE_MARK_AT(TurnMark::SpeechStart, utterance.speechStart);
+            TRACE_MARK_AT(TurnMark::CaptureEnd, utterance.captureEnd);
+            TRACE_MARK_AT(TurnMark::SttStart, utterance.sttStart);
+            TRACE_MARK_AT(TurnMark::SttEnd, utterance.sttEnd);
+            // STT ran ahead of this turn, its totals came along with the transcript
+            TRACE_COUNT(TurnCount::UtteranceSeconds, utterance.audioSeconds);
+            TRACE_COUNT(TurnCount::SttSeconds, utterance.whisperSeconds);
+        }
+
+        // retrieved notes go into the user turn so the pinned system prompt stays cached
+        std::string context;
+        if (rag_) {
+            TRACE_SCOPE("rag");
+            context = rag_->buildContext(utterance.text);
+        }
+
+        std::string prompt =
             "<|im_start|>user\n" +
-            userText +
+            context +
+            utterance.text +
             "\n<|im_end|>\n"
             "<|im_start|>assistant\n";
 
-        std::cout << "\n=== Response ===\n";
+        if (!phraseQueue_.push({ PhraseItem::BeginTurn, {}, utterance.captureEnd })) break;
+
+        cancel_.reset();
+        interrupted_ = false;
+        replyActive_ = true;
 
-        tts_->startStreaming();
-        std::string sentence;
+        std::cout << "\n=== Response ===\n";
+        chunker.reset();
+        PhraseChunk phrase;
 
-        llm_->generate(prompt, 1024,
-            [&](const std::string& tok) {
+        llm_->generateStream(prompt, 1024,
+            [&](std::string_view tok) {
 
                 // HARD GUARD: never emit control tokens
-                if (tok.find("<|") != std::string::npos)
+                if (tok.find("<|") != std::string::npos) {
+                    chunker.skip(tok.size());
                     return;
+                }
 
                 std::cout << tok << std::flush;
-                sentence += tok;
-
-                // Break on phrase boundaries for faster initial response
-                while (true) {
-                    size_t pos = sentence.find_first_of(".!?,;:-()");
-                    size_t emDashPos = sentence.find("\xe2\x80\x94"); // em-dash UTF-8
-
-                    // Pick whichever comes first
-                    size_t breakLen = 1;
-                    if (emDashPos != std::string::npos && (pos == std::string::npos || emDashPos < pos)) {
-                        pos = emDashPos;
-                        breakLen = 3; // em-dash is 3 bytes
-                    }
 
-                    if (pos == std::string::npos) break;
+                // phrases grow while synthesis keeps ahead of playback
+                chunker.setFeedback(tts_->realTimeFactor(), tts_->bufferedSeconds());
+                chunker.append(tok);
+                while (chunker.next(phrase)) {
+                    phraseQueue_.push({ PhraseItem::Phrase, std::move(phrase.text), {}, phrase.end, phrase.start });
+                }
+            },
+            nullptr, &cancel_
+        );
 
-                    std::string out = sentence.substr(0, pos + breakLen);
+        while (!cancel_.cancelled() && chunker.finish(phrase)) {
+            phraseQueue_.push({ PhraseItem::Phrase, std::move(phrase.text), {}, phrase.end, phrase.start });
+        }
 
-                    // Defensive cleanup before TTS
-                    out.erase(std::remove(out.begin(), out.end(), '<'), out.end());
-                    out.erase(std::remove(out.begin(), out.end(), '>'), out.end());
+        phraseQueue_.push({ PhraseItem::EndTurn, {}, {} });
+    }
+    phraseQueue_.close();
+}
 
-                    // Skip tiny chunks (just punctuation)
-                    if (out.size() > 2) {
-                        tts_->queueText(out);
-                    }
-                    sentence.erase(0, pos + breakLen);
+void Assistant::ttsStage() {
+    TRACE_THREAD_NAME("tts stage");
+    PhraseItem item;
+    bool inTurn = false;
+    Clock::time_point captureEnd;
+    std::vector<PhraseItem> phrases;   // this turn's, in the order TTS numbers them
+
+    while (phraseQueue_.pop(item)) {
+        switch (item.kind) {
+            case PhraseItem::BeginTurn:
+                tts_->startStreaming();
+                inTurn = true;
+                captureEnd = item.captureEnd;
+                phrases.clear();
+                break;
+
+            case PhraseItem::Phrase:
+                tts_->queueText(item.text);
+                phrases.push_back(std::move(item));
+                break;
+
+            case PhraseItem::EndTurn:
+                tts_->finishStreaming();
+                inTurn = false;
+                std::cout << "\n\n";
+                if (interrupted_) truncateInterruptedReply(phrases);
+                replyActive_ = false;
+                reportTurn(captureEnd);
+
+                // capture has been dropping what the microphone heard of
+                // the reply, it is the ring's only reader
+                replying_ = false;
+                std::cout << "[Listening...]\n";
+
+                {
+                    std::lock_guard<std::mutex> lock(turnMutex_);
+                    turnsPlayed_++;
                 }
-            }
-        );
-
-        if (!sentence.empty()) {
-            sentence.erase(std::remove(sentence.begin(), sentence.end(), '<'), sentence.end());
-            sentence.erase(std::remove(sentence.begin(), sentence.end(), '>'), sentence.end());
-            tts_->queueText(sentence);
+                turnCv_.notify_all();
+                break;
         }
+    }
 
+    // stopped halfway through a reply, let it play out
+    if (inTurn) {
         tts_->finishStreaming();
-        std::cout << "\n\n";
     }
 }
 
+// Only what was heard of an interrupted reply stays in the context. Whole
+// phrases count by their end in the reply, the one cut off by how much of
+// its audio played, rounded back to a word boundary.
+void Assistant::truncateInterruptedReply(const std::vector<PhraseItem>& phrases) {
+    double spoken = tts_->spokenPhrases();
+    size_t whole = std::min(static_cast<size_t>(spoken), phrases.size());
+
+    size_t bytes = whole > 0 ? phrases[whole - 1].replyEnd : 0;
+    if (whole < phrases.size()) {
+        const std::string& text = phrases[whole].text;
+        size_t heard = static_cast<size_t>((spoken - static_cast<double>(whole)) * static_cast<double>(text.size()));
+        size_t space = heard > 0 ? text.rfind(' ', heard) : std::string::npos;
+        // the phrase's text starts after the whitespace the chunker trimmed
+        if (space != std::string::npos) bytes = phrases[whole].replyStart + space;
+    }
+
+    if (!llm_->truncateReply(bytes)) {
+        std::cerr << "Failed to trim the interrupted reply\n";
+        return;
+    }
+    std::cout << "[interrupted after " << whole << " of " << phrases.size() << " phrases, "
+              << bytes << " bytes of the reply kept]\n\n";
+}
+
+void Assistant::reportTurn(Clock::time_point captureEnd) {
+    if (tts_->timeToFirstAudioMs() >= 0.0) {
+        auto sinceSpeech = std::chrono::duration_cast<std::chrono::milliseconds>(tts_->firstAudioTime() - captureEnd).count();
+        std::cout << "[first audio " << sinceSpeech << " ms after end of speech, "
+                  << static_cast<int>(tts_->timeToFirstAudioMs()) << " ms after TTS start]\n\n";
+    }
+
+    if (traceEnabled()) {
+        TurnSummary turn = Trace::endTurn();
+        printf("[turn: stt %.0f ms, prefill %.0f ms, ttft %.0f ms, ttfa %.0f ms, %d tokens at %.1f tok/s, "
+               "stt rtf %.2f, tts rtf %.2f]\n\n",
+               turn.stt_ms, turn.prefill_ms, turn.ttft_ms, turn.ttfa_ms, turn.tokens, turn.tokens_per_second,
+               turn.stt_rtf, turn.tts_rtf);
+    }
+
+    PhraseCacheStats cache = tts_->cacheStats();
+    if (cache.hits + cache.misses > 0) {
+        std::cout << "[tts cache " << cache.hits << "/" << (cache.hits + cache.misses) << " hits, "
+                  << cache.entries << " phrases, " << cache.bytes / 1024 << " KiB]\n\n";
+    }
+
+    if (tts_->underruns() > 0) {
+        std::cout << "[" << tts_->underruns() << " playback underruns]\n\n";
+    }
+
+    // the LLM is waiting for this turn to finish, its stats are still the last reply's
+    if (allocationCountingEnabled()) {
+        const GenerationStats& gen = llm_->lastGeneration();
+        std::cout << "[" << gen.n_tokens << " tokens, " << static_cast<int>(gen.tokensPerSecond())
+                  << " tok/s, " << gen.allocationsPerToken() << " allocs/token]\n\n";
+    }
+
+    if (llm_->isSpeculative()) {
+        std::cout << "[draft acceptance " << static_cast<int>(llm_->speculativeStats().acceptanceRate() * 100.0) << "%]\n\n";
+    }
+
+    if (pipeline_.print_queue_stats) {
+        printQueueStats();
+    }
+}
+
+void Assistant::printQueueStats() {
+    QueueStats stats[] = { audioQueue_.stats(), transcriptQueue_.stats(), phraseQueue_.stats() };
+    const char* names[] = { audioQueue_.name(), transcriptQueue_.name(), phraseQueue_.name() };
+
+    std::cout << "[queues";
+    for (size_t i = 0; i < 3; i++) {
+        const QueueStats& q = stats[i];
+        std::cout << (i ? ", " : " ") << names[i] << " " << q.depth << "/" << q.capacity << " max " << q.max_depth;
+        if (q.full_waits > 0) {
+            std::cout << " (" << q.full_waits << " waits, " << static_cast<int>(q.full_wait_ms) << " ms)";
+        }
+    }
+    std::cout << "]\n";
+
+    CaptureStats capture = audio_->stats();
+    ArenaStats arenas = arenas_.stats();
+    std::cout << "[capture ring max " << capture.max_fill * 100 / std::max<ma_uint32>(capture.capacity, 1) << "% full, "
+              << capture.overruns << " overruns (" << capture.dropped_frames * 1000 / 16000 << " ms lost), arenas "
+              << arenas.in_use << "/" << arenas.count << " in use";
+    if (arenas.waits > 0) {
+        std::cout << " (" << arenas.waits << " waits, " << static_cast<int>(arenas.wait_ms) << " ms)";
+    }
+    if (arenas.truncated > 0) {
+        std::cout << ", " << arenas.truncated * 1000 / 16000 << " ms truncated";
+    }
+    std::cout << "]\n\n";
+}
+
 void Assistant::shutdown() {
     delete audio_; audio_ = nullptr;
+    delete vad_;   vad_   = nullptr;
     delete stt_;   stt_   = nullptr;
     delete llm_;   llm_   = nullptr;
     delete tts_;   tts_   = nullptr;
+    delete rag_;   rag_   = nullptr;
+    if (traceEnabled()) Trace::close();
 }
@@ -1,11 +1,22 @@
 #ifndef PIPELINE_H
 #define PIPELINE_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <vector>
+#include "bounded_queue.h"
+#include "phrase_chunker.h"
 #include "../audio/audio_capture.h"
+#include "../audio/barge_in.h"
+#include "../audio/utterance_arena.h"
+#include "../audio/vad.h"
 #include "../transcribe/transcribe.h"
 #include "../llm/text_inference.h"
 #include "../tts/tts.h"
+#include "../rag/retriever.h"
 
 class Transcribe;
 
@@ -22,24 +33,130 @@ struct KokoroConfig {
     std::string voices;
 };
 
+// Stage capacities. A full queue blocks the stage feeding it; capture is
+// held back last, the capture ring gives it a few more seconds of slack.
+struct PipelineConfig {
+    size_t audio_queue = 64;      // 100 ms of new audio each, from capture to whisper
+    size_t utterance_arenas = 3;  // utterances held at once: one recording, the rest waiting on whisper
+    size_t transcript_queue = 4;  // finished utterances waiting for the LLM
+    size_t phrase_queue = 32;     // phrases waiting for TTS
+
+    // keep capturing and transcribing while a reply plays, so the next
+    // utterance is ready when playback ends; turn it off when the speakers
+    // are loud enough for the microphone to pick the reply up
+    bool listen_while_speaking = true;
+
+    // talking over a reply stops it, needs listen_while_speaking. The
+    // detector also keeps the reply's own echo from starting an utterance.
+    bool barge_in = true;
+    BargeInConfig barge_in_config;
+
+    bool print_queue_stats = true;  // depth and back-pressure after every turn
+
+    PhraseChunkerConfig chunker;    // how the reply is cut up for TTS
+};
+
 class Assistant {
 
 public:
-    Assistant(): audio_(nullptr), stt_(nullptr), llm_(nullptr), tts_(nullptr) {}
+    Assistant(): audio_(nullptr), vad_(nullptr), stt_(nullptr), llm_(nullptr), tts_(nullptr), rag_(nullptr),
+                 audioQueue_("audio"), transcriptQueue_("transcripts"), phraseQueue_("phrases") {}
     ~Assistant() { shutdown(); }
 
     bool init(const std::string& whisper_model,
               const std::string& llama_model,
+              const std::string& draft_model,
               const PiperConfig& piper,
-              const KokoroConfig& kokoro);
+              const KokoroConfig& kokoro,
+              const AudioIOConfig& input = AudioIOConfig(),
+              const AudioIOConfig& output = AudioIOConfig());
+
+    // optional: ground replies in a document index built with jarvis_rag_build
+    bool enableRag(const RagConfig& config);
+
+    // before run(), queue sizes only take effect then
+    void setPipelineConfig(const PipelineConfig& config) { pipeline_ = config; }
+
     void run();
     void shutdown();
 
 private:
     AudioCapture* audio_;
+    VoiceActivityDetector* vad_;
     Transcribe* stt_;
     TextInference* llm_;
     TextToSpeech* tts_;
+    Retriever* rag_;
+
+    // Staged pipeline, one thread per stage:
+    //   capture + VAD -> audio -> whisper -> transcripts -> LLM -> phrases -> TTS
+    using Clock = std::chrono::steady_clock;
+
+    // The samples themselves are in the arena, capture appends and whisper
+    // reads the same memory; a chunk only says there is more of it.
+    struct AudioChunk {
+        enum Kind { Begin, Samples, End } kind;
+        UtteranceArena* arena;
+        Clock::time_point speechStart;   // Begin
+        Clock::time_point captureEnd;    // End
+    };
+
+    struct Utterance {
+        std::string text;
+        Clock::time_point speechStart;
+        Clock::time_point captureEnd;
+        Clock::time_point sttStart;
+        Clock::time_point sttEnd;
+        double audioSeconds = 0.0;      // booked to the turn once the LLM stage starts it
+        double whisperSeconds = 0.0;
+    };
+
+    struct PhraseItem {
+        enum Kind { BeginTurn, Phrase, EndTurn } kind;
+        std::string text;
+        Clock::time_point captureEnd;    // BeginTurn
+        size_t replyEnd = 0;             // Phrase: bytes of the reply up to its end
+        size_t replyStart = 0;           // Phrase: bytes of the reply before its text
+    };
+
+    PipelineConfig pipeline_;
+    UtteranceArenaPool arenas_;           // allocated by run(), released by the STT stage
+    BoundedQueue<AudioChunk> audioQueue_;
+    BoundedQueue<Utterance> transcriptQueue_;
+    BoundedQueue<PhraseItem> phraseQueue_;
+
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> replying_{false};   // end of an utterance until its reply has played, half duplex only
+
+    // Barge-in: while a reply is generated or played, capture compares the
+    // microphone with the playback level and cancels both when the user
+    // talks over it. The TTS stage then trims the reply in the context to
+    // what was heard.
+    CancelToken cancel_;
+    BargeInDetector bargeIn_;
+    std::atomic<bool> replyActive_{false};
+    std::atomic<bool> interrupted_{false};
+
+    // the LLM starts a reply once the previous one has played out
+    uint64_t turnsPlayed_ = 0;
+    std::mutex turnMutex_;
+    std::condition_variable turnCv_;
+
+    void captureStage();
+    void sttStage();
+    void llmStage();
+    void ttsStage();
+    void stop();
+    void reportTurn(Clock::time_point captureEnd);
+    void truncateInterruptedReply(const std::vector<PhraseItem>& phrases);
+    void printQueueStats();
+
+    // endpointing
+    static constexpr size_t CHUNK_SAMPLES = 1600;                  // 100ms read from the ring at a time
+    static constexpr size_t PREROLL_SAMPLES = 16000 * 3 / 10;      // 300ms before speech onset
+    static constexpr size_t BARGE_IN_PREROLL_SAMPLES = 16000 * 8 / 10;  // barge-in fires late, keep its first words
+    static constexpr size_t MAX_UTTERANCE_SAMPLES = 16000 * 30;    // force the end of a turn after 30s
+    static constexpr size_t ARENA_SAMPLES = MAX_UTTERANCE_SAMPLES + BARGE_IN_PREROLL_SAMPLES + CHUNK_SAMPLES;
 };
 
 #endif
\ No newline at end of file
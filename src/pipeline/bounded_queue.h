@@ -0,0 +1,101 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+// occupancy and back-pressure of one queue since it was created
+struct QueueStats {
+    size_t depth = 0;
+    size_t capacity = 0;
+    size_t max_depth = 0;
+    uint64_t pushed = 0;
+    uint64_t full_waits = 0;        // pushes that had to wait for the consumer
+    double full_wait_ms = 0.0;      // producer time spent waiting for space
+};
+
+// Hand-off between two pipeline stages. push() blocks while the queue is
+// full, so a slow stage holds back the one feeding it instead of letting
+// work pile up. close() wakes both sides: push() then fails and pop()
+// drains what is left before failing.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(const char* name, size_t capacity = 1) : name_(name), capacity_(capacity > 0 ? capacity : 1) {}
+
+    const char* name() const { return name_; }
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (items_.size() >= capacity_ && !closed_) {
+            auto start = std::chrono::steady_clock::now();
+            notFull_.wait(lock, [&] { return items_.size() < capacity_ || closed_; });
+            stats_.full_waits++;
+            stats_.full_wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        if (closed_) return false;
+
+        items_.push_back(std::move(item));
+        stats_.pushed++;
+        if (items_.size() > stats_.max_depth) stats_.max_depth = items_.size();
+        lock.unlock();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    // false once the queue is closed and empty
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+
+        out = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        notFull_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+    // empty, reopen and resize; only while neither side is running
+    void reset(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = capacity > 0 ? capacity : 1;
+        items_.clear();
+        closed_ = false;
+        stats_ = QueueStats();
+    }
+
+    QueueStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        QueueStats s = stats_;
+        s.depth = items_.size();
+        s.capacity = capacity_;
+        return s;
+    }
+
+private:
+    const char* name_;
+    size_t capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    QueueStats stats_;
+};
+
+#endif
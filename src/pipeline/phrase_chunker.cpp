@@ -0,0 +1,175 @@
+#include "phrase_chunker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+// roughly how fast the voices speak, turns seconds of lead into text
+static constexpr double CHARS_PER_SECOND = 14.0;
+
+// a period after these is not the end of a sentence
+static const char* ABBREVIATIONS[] = {
+    "mr", "mrs", "ms", "dr", "prof", "sr", "jr", "st", "vs", "mt", "ave", "approx", "fig", "e.g", "i.e", "u.s",
+};
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+// end, or the start of the UTF-8 sequence it would split
+static size_t charBoundary(const std::string& text, size_t end) {
+    size_t lead = end - 1;
+    while (lead > 0 && (text[lead] & 0xC0) == 0x80) lead--;
+
+    const unsigned char c = static_cast<unsigned char>(text[lead]);
+    const size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    return lead > 0 && lead + len > end ? lead : end;
+}
+
+void PhraseChunker::reset() {
+    buffer_.clear();
+    base_ = 0;
+    scanned_ = 0;
+    lastClause_ = 0;
+    lastSpace_ = 0;
+    emitted_ = 0;
+    ready_.clear();
+}
+
+void PhraseChunker::append(std::string_view text) {
+    buffer_.append(text.data(), text.size());
+    scan();
+}
+
+bool PhraseChunker::next(PhraseChunk& out) {
+    if (ready_.empty()) return false;
+    out = std::move(ready_.front());
+    ready_.pop_front();
+    return true;
+}
+
+bool PhraseChunker::finish(PhraseChunk& out) {
+    if (!buffer_.empty()) cut(buffer_.size());
+    return next(out);
+}
+
+// Later phrases may be as long as can be synthesized before the audio
+// already queued runs out, but no shorter than the first phrase could be.
+size_t PhraseChunker::limit() const {
+    if (emitted_ == 0) return config_.first_max_chars;
+    if (rtf_ <= 0.0) return config_.max_chars;
+    double chars = lead_ / rtf_ * CHARS_PER_SECOND;
+    return std::clamp(static_cast<size_t>(chars), std::min(config_.first_max_chars, config_.max_chars), config_.max_chars);
+}
+
+bool PhraseChunker::endsSentence(size_t dot) const {
+    // the word in front of the period
+    size_t start = dot;
+    while (start > 0 && !isSpace(buffer_[start - 1]) && dot - start < 8) start--;
+    size_t len = dot - start;
+    if (len == 0) return true;
+
+    // "J. Smith"
+    if (len == 1 && std::isalpha(static_cast<unsigned char>(buffer_[start]))) return false;
+
+    for (const char* abbreviation : ABBREVIATIONS) {
+        if (strlen(abbreviation) != len) continue;
+        bool same = true;
+        for (size_t i = 0; i < len && same; i++) {
+            same = std::tolower(static_cast<unsigned char>(buffer_[start + i])) == abbreviation[i];
+        }
+        if (same) return false;
+    }
+    return true;
+}
+
+// Boundaries are classified at the whitespace after them, so nothing needs
+// to be looked at twice and a period at the end of the text waits for the
+// next piece to tell "3." from "3.5".
+void PhraseChunker::scan() {
+    while (scanned_ < buffer_.size()) {
+        size_t i = scanned_++;
+        char c = buffer_[i];
+
+        // never spoken, and sherpa-onnx reads them out
+        if (c == '<' || c == '>') buffer_[i] = c = ' ';
+
+        if (!isSpace(c)) {
+            // em-dash, a pause whether or not it has spaces around it
+            if (i >= 2 && buffer_.compare(i - 2, 3, "\xe2\x80\x94") == 0) {
+                consider(Boundary::Clause, i + 1);
+            }
+        } else if (i > 0 && !isSpace(buffer_[i - 1])) {
+            lastSpace_ = i;
+
+            // look through closing quotes and brackets
+            size_t p = i - 1;
+            while (p > 0 && (buffer_[p] == '"' || buffer_[p] == '\'' || buffer_[p] == ')') && i - p < 3) p--;
+
+            switch (buffer_[p]) {
+                case '.':
+                    if (endsSentence(p)) consider(Boundary::Sentence, i);
+                    break;
+                case '!':
+                case '?':
+                    consider(Boundary::Sentence, i);
+                    break;
+                case ',':
+                case ';':
+                case ':':
+                    consider(Boundary::Clause, i);
+                    break;
+                case '-':
+                    // " - " as a dash, not "well-known"
+                    if (p > 0 && isSpace(buffer_[p - 1])) consider(Boundary::Clause, i);
+                    break;
+            }
+        }
+
+        if (scanned_ >= limit()) {
+            // too long without a good place to stop: the last clause, else the last word
+            if (lastClause_ > 0) cut(lastClause_);
+            else if (lastSpace_ > 0) cut(lastSpace_);
+            else cut(charBoundary(buffer_, scanned_));
+        }
+    }
+}
+
+void PhraseChunker::consider(Boundary kind, size_t end) {
+    lastClause_ = end;
+
+    const bool lowLead = lead_ < config_.low_lead_seconds;
+    bool take;
+    if (emitted_ == 0) {
+        take = kind == Boundary::Sentence || end >= config_.first_min_chars;
+    } else if (kind == Boundary::Sentence) {
+        take = end >= config_.min_chars || lowLead;
+    } else {
+        take = end >= config_.min_chars && lowLead;
+    }
+    if (take) cut(end);
+}
+
+void PhraseChunker::cut(size_t end) {
+    size_t first = 0;
+    while (first < end && isSpace(buffer_[first])) first++;
+    size_t last = end;
+    while (last > first && isSpace(buffer_[last - 1])) last--;
+
+    // lone punctuation has nothing to say
+    bool speakable = false;
+    for (size_t i = first; i < last && !speakable; i++) {
+        speakable = std::isalnum(static_cast<unsigned char>(buffer_[i])) || (buffer_[i] & 0x80);
+    }
+    if (speakable) {
+        ready_.push_back({ buffer_.substr(first, last - first), base_ + first, base_ + end });
+        emitted_++;
+    }
+
+    // what is left is less than a phrase, moving it down is cheap
+    buffer_.erase(0, end);
+    base_ += end;
+    scanned_ -= std::min(scanned_, end);
+    lastClause_ = lastClause_ > end ? lastClause_ - end : 0;
+    lastSpace_ = lastSpace_ > end ? lastSpace_ - end : 0;
+}
@@ -0,0 +1,79 @@
+#ifndef PHRASE_CHUNKER_H
+#define PHRASE_CHUNKER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+// Sizes are in bytes of reply text.
+struct PhraseChunkerConfig {
+    size_t first_min_chars = 12;    // first phrase: the first clause after this many, for a quick start
+    size_t first_max_chars = 60;    // ... or a word boundary once this long
+    size_t min_chars = 40;          // later phrases: shorter sentences are merged with the next
+    size_t max_chars = 240;         // never longer, even when synthesis is far ahead
+    double low_lead_seconds = 1.0;  // less audio than this ahead of the listener also cuts at clauses
+};
+
+struct PhraseChunk {
+    std::string text;
+    size_t start = 0;   // bytes of input before the phrase, trimmed whitespace included
+    size_t end = 0;     // bytes of input up to the end of the phrase
+};
+
+// Cuts a streamed reply into phrases for TTS. The first phrase is short so
+// speech starts early; after that phrases end at sentences and grow as long
+// as synthesis stays ahead of playback, which sounds better and pays
+// sherpa-onnx's per-call overhead less often. Falls back to clauses while
+// little audio is buffered. Each appended byte is looked at once.
+//
+// A boundary is punctuation followed by whitespace, so "3.5", "1,000" and
+// "well-known" never split, and a period after an abbreviation ("Dr.",
+// "e.g.") or a single initial does not end a sentence.
+class PhraseChunker {
+public:
+    explicit PhraseChunker(const PhraseChunkerConfig& config = PhraseChunkerConfig()) : config_(config) {}
+
+    // start of a reply
+    void reset();
+
+    // rtf: seconds of synthesis per second of speech, 0 if unknown.
+    // lead: seconds of synthesized audio not yet played.
+    void setFeedback(double rtf, double leadSeconds) { rtf_ = rtf; lead_ = leadSeconds; }
+
+    void append(std::string_view text);
+
+    // input that is not spoken (control tokens), counted so phrase ends stay byte offsets of the input
+    void skip(size_t n) { buffer_.append(n, ' '); scan(); }
+
+    // the next complete phrase, false when more text is needed
+    bool next(PhraseChunk& out);
+
+    // end of the reply: the phrases left, one per call, then false
+    bool finish(PhraseChunk& out);
+
+    size_t phrases() const { return emitted_; }
+
+private:
+    enum class Boundary { Clause, Sentence };
+
+    void scan();
+    void consider(Boundary kind, size_t end);
+    void cut(size_t end);
+    size_t limit() const;
+    bool endsSentence(size_t dot) const;
+
+    PhraseChunkerConfig config_;
+    double rtf_ = 0.0;
+    double lead_ = 0.0;
+
+    std::string buffer_;        // text not emitted yet
+    size_t base_ = 0;           // input offset of buffer_[0]
+    size_t scanned_ = 0;        // buffer_ bytes already classified
+    size_t lastClause_ = 0;     // latest clause or sentence end in buffer_, 0 if none
+    size_t lastSpace_ = 0;      // latest word end in buffer_, 0 if none
+    size_t emitted_ = 0;
+    std::deque<PhraseChunk> ready_;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "document.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static bool isTextFile(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    return ext == ".txt" || ext == ".md" || ext == ".markdown";
+}
+
+static bool readFile(const std::filesystem::path& path, std::vector<Document>& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open " << path.string() << "\n";
+        return false;
+    }
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+    out.push_back({ path.string(), ss.str() });
+    return true;
+}
+
+bool loadDocuments(const std::string& path, std::vector<Document>& out) {
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(path, ec)) {
+        return readFile(path, out);
+    }
+
+    if (!std::filesystem::is_directory(path, ec)) {
+        std::cerr << "No such file or directory: " << path << "\n";
+        return false;
+    }
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+        if (entry.is_regular_file() && isTextFile(entry.path())) {
+            readFile(entry.path(), out);
+        }
+    }
+    return true;
+}
+
+// best place to cut text[begin, end): paragraph, then sentence, then word boundary
+static size_t findCut(const std::string& text, size_t begin, size_t end) {
+    size_t minCut = begin + (end - begin) / 2;
+
+    // both newlines must fall before end
+    size_t para = end >= 2 ? text.rfind("\n\n", end - 2) : std::string::npos;
+    if (para != std::string::npos && para > minCut) return para + 2;
+
+    for (size_t i = end; i > minCut; i--) {
+        char c = text[i - 1];
+        if ((c == '.' || c == '!' || c == '?' || c == '\n') && (i == text.size() || text[i] == ' ' || text[i] == '\n')) {
+            return i;
+        }
+    }
+
+    size_t space = text.rfind(' ', end - 1);
+    if (space != std::string::npos && space > minCut) return space + 1;
+
+    return end;
+}
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return s.substr(b, e - b + 1);
+}
+
+void chunkDocument(const Document& doc, const ChunkerConfig& config, std::vector<Chunk>& out) {
+    const std::string& text = doc.text;
+    const size_t maxChars = std::max<size_t>(config.max_chars, 64);
+    const size_t overlap = std::min(config.overlap_chars, maxChars / 2);
+
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = std::min(begin + maxChars, text.size());
+        if (end < text.size()) {
+            end = findCut(text, begin, end);
+        }
+
+        std::string chunk = trim(text.substr(begin, end - begin));
+        if (!chunk.empty()) {
+            out.push_back({ doc.source, std::move(chunk) });
+        }
+
+        if (end >= text.size()) break;
+
+        // step back for overlap, but start the next chunk on a word
+        size_t next = end > overlap ? end - overlap : end;
+        size_t space = text.find(' ', next);
+        begin = (space != std::string::npos && space < end) ? space + 1 : end;
+    }
+}
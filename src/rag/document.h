@@ -0,0 +1,29 @@
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <string>
+#include <vector>
+
+struct Document {
+    std::string source;   // file path the text came from
+    std::string text;
+};
+
+struct Chunk {
+    std::string source;
+    std::string text;
+};
+
+struct ChunkerConfig {
+    size_t max_chars = 800;     // target chunk size, roughly 200 tokens
+    size_t overlap_chars = 100; // text repeated from the end of the previous chunk
+};
+
+// load a text/markdown file, or every such file under a directory
+bool loadDocuments(const std::string& path, std::vector<Document>& out);
+
+// Split on paragraph and sentence boundaries into chunks of at most max_chars,
+// carrying overlap_chars of context over from the previous chunk.
+void chunkDocument(const Document& doc, const ChunkerConfig& config, std::vector<Chunk>& out);
+
+#endif
@@ -0,0 +1,97 @@
+#include "embedder.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+bool Embedder::init(const std::string& model_path, int gpu_layers, int max_tokens) {
+    llama_model_params model_params = llama_model_default_params();
+    model_params.n_gpu_layers = gpu_layers;
+
+    llama_log_set([](enum ggml_log_level, const char*, void*) {}, nullptr);
+
+    model_ = llama_model_load_from_file(model_path.c_str(), model_params);
+    if (!model_) return false;
+
+    // non-causal models need the whole input in one micro-batch
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = max_tokens;
+    ctx_params.n_batch = max_tokens;
+    ctx_params.n_ubatch = max_tokens;
+    ctx_params.embeddings = true;
+
+    ctx_ = llama_init_from_model(model_, ctx_params);
+    if (!ctx_) {
+        llama_model_free(model_);
+        model_ = nullptr;
+        return false;
+    }
+
+    dim_ = llama_model_n_embd(model_);
+    max_tokens_ = max_tokens;
+    batch_ = llama_batch_init(max_tokens, 0, 1);
+    tokens_.resize(max_tokens);
+    return true;
+}
+
+bool Embedder::embed(const std::string& text, std::vector<float>& out) {
+    const llama_vocab* vocab = llama_model_get_vocab(model_);
+
+    int n = llama_tokenize(vocab, text.c_str(), text.size(), tokens_.data(), max_tokens_, true, false);
+    if (n < 0) {
+        // longer than the context, keep the beginning
+        std::vector<llama_token> all(-n);
+        llama_tokenize(vocab, text.c_str(), text.size(), all.data(), -n, true, false);
+        memcpy(tokens_.data(), all.data(), max_tokens_ * sizeof(llama_token));
+        n = max_tokens_;
+    }
+    if (n == 0) return false;
+
+    for (int i = 0; i < n; i++) {
+        batch_.token[i] = tokens_[i];
+        batch_.pos[i] = i;
+        batch_.n_seq_id[i] = 1;
+        batch_.seq_id[i][0] = 0;
+        batch_.logits[i] = true;
+    }
+    batch_.n_tokens = n;
+
+    // every text is embedded on its own, nothing carries over
+    llama_memory_t mem = llama_get_memory(ctx_);
+    if (mem) llama_memory_clear(mem, true);
+
+    int rc = (llama_model_has_encoder(model_) && !llama_model_has_decoder(model_))
+        ? llama_encode(ctx_, batch_)
+        : llama_decode(ctx_, batch_);
+    if (rc != 0) {
+        fprintf(stderr, "embedding failed\n");
+        return false;
+    }
+
+    out.assign(dim_, 0.0f);
+    if (llama_pooling_type(ctx_) == LLAMA_POOLING_TYPE_NONE) {
+        // model has no pooling of its own, average the token embeddings
+        for (int i = 0; i < n; i++) {
+            const float* e = llama_get_embeddings_ith(ctx_, i);
+            for (int d = 0; d < dim_; d++) out[d] += e[d] / n;
+        }
+    } else {
+        const float* e = llama_get_embeddings_seq(ctx_, 0);
+        if (!e) return false;
+        memcpy(out.data(), e, dim_ * sizeof(float));
+    }
+
+    double norm = 0.0;
+    for (float v : out) norm += static_cast<double>(v) * v;
+    norm = std::sqrt(norm);
+    if (norm > 0.0) {
+        for (float& v : out) v = static_cast<float>(v / norm);
+    }
+    return true;
+}
+
+void Embedder::shutdown() {
+    if (batch_.token) { llama_batch_free(batch_); batch_ = llama_batch{}; }
+    if (ctx_)   { llama_free(ctx_); ctx_ = nullptr; }
+    if (model_) { llama_model_free(model_); model_ = nullptr; }
+}
@@ -0,0 +1,30 @@
+#ifndef EMBEDDER_H
+#define EMBEDDER_H
+
+#include <string>
+#include <vector>
+#include <llama.h>
+
+// Sentence embeddings from a GGUF embedding model via llama.cpp's embedding mode.
+// Vectors are L2-normalized, so inner product equals cosine similarity.
+class Embedder {
+public:
+    Embedder() : model_(nullptr), ctx_(nullptr), dim_(0), max_tokens_(0) {}
+    ~Embedder() { shutdown(); }
+
+    bool init(const std::string& model_path, int gpu_layers, int max_tokens = 512);
+    bool embed(const std::string& text, std::vector<float>& out);
+    int dim() const { return dim_; }
+
+    void shutdown();
+
+private:
+    llama_model* model_;
+    llama_context* ctx_;
+    llama_batch batch_{};
+    std::vector<llama_token> tokens_;
+    int dim_;
+    int max_tokens_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "exact_search.h"
+
+#include <algorithm>
+#include <cmath>
+
+// heap ordering that keeps the lowest score at the front
+static bool worseFirst(const SearchResult& a, const SearchResult& b) {
+    return a.score > b.score;
+}
+
+void TopK::reset(size_t k) {
+    k_ = k;
+    heap_.clear();
+    heap_.reserve(k);
+}
+
+void TopK::push(size_t id, float score) {
+    if (k_ == 0) return;
+    if (heap_.size() < k_) {
+        heap_.push_back({ id, score });
+        std::push_heap(heap_.begin(), heap_.end(), worseFirst);
+    } else if (score > heap_.front().score) {
+        std::pop_heap(heap_.begin(), heap_.end(), worseFirst);
+        heap_.back() = { id, score };
+        std::push_heap(heap_.begin(), heap_.end(), worseFirst);
+    }
+}
+
+void TopK::take(std::vector<SearchResult>& out) {
+    // sort_heap under the min-heap ordering leaves the best score first
+    std::sort_heap(heap_.begin(), heap_.end(), worseFirst);
+    out.assign(heap_.begin(), heap_.end());
+    heap_.clear();
+}
+
+bool ExactSearcher::init(const VectorStore* store, Metric metric) {
+    store_ = store;
+    metric_ = metric;
+    queryI8_.resize(store->dim());
+
+    // norms are computed on first use, so opening a big index behind HNSW
+    // does not touch every vector; a rerank only pays for its candidates
+    invNorms_.clear();
+    return true;
+}
+
+float ExactSearcher::invNorm(size_t i) {
+    if (invNorms_.empty()) invNorms_.assign(store_->size(), -1.0f);
+    if (invNorms_[i] >= 0.0f) return invNorms_[i];
+
+    const size_t dim = store_->dim();
+    float norm;
+    if (store_->type() == VectorType::I8) {
+        const int8_t* q = static_cast<const int8_t*>(store_->vectorData(i));
+        norm = store_->scale(i) * std::sqrt(static_cast<float>(kernels_->i8(q, q, dim)));
+    } else {
+        std::vector<float>& v = vectorScratch_;
+        v.resize(dim);
+        store_->vector(i, v.data());
+        norm = std::sqrt(kernels_->f32(v.data(), v.data(), dim));
+    }
+    invNorms_[i] = norm > 0.0f ? 1.0f / norm : 0.0f;
+    return invNorms_[i];
+}
+
+void ExactSearcher::prepare(const float* query) {
+    const size_t dim = store_->dim();
+    query_ = query;
+
+    queryInvNorm_ = 1.0f;
+    if (metric_ == Metric::Cosine) {
+        float norm = std::sqrt(kernels_->f32(query, query, dim));
+        queryInvNorm_ = norm > 0.0f ? 1.0f / norm : 0.0f;
+    }
+
+    if (store_->type() == VectorType::I8) {
+        queryScale_ = quantizeI8(query, dim, queryI8_.data());
+    }
+}
+
+float ExactSearcher::score(size_t i) {
+    const size_t dim = store_->dim();
+    const void* v = store_->vectorData(i);
+
+    float s = 0.0f;
+    switch (store_->type()) {
+        case VectorType::F32:
+            s = kernels_->f32(query_, static_cast<const float*>(v), dim);
+            break;
+        case VectorType::F16:
+            s = kernels_->f16(query_, static_cast<const uint16_t*>(v), dim);
+            break;
+        case VectorType::I8:
+            s = kernels_->i8(queryI8_.data(), static_cast<const int8_t*>(v), dim)
+                * queryScale_ * store_->scale(i);
+            break;
+    }
+
+    if (metric_ == Metric::Cosine) s *= queryInvNorm_ * invNorm(i);
+    return s;
+}
+
+void ExactSearcher::search(const float* query, size_t k, std::vector<SearchResult>& out) {
+    prepare(query);
+    top_.reset(k);
+    for (size_t i = 0; i < store_->size(); i++) {
+        top_.push(i, score(i));
+    }
+    top_.take(out);
+}
+
+void ExactSearcher::rerank(const float* query, const std::vector<SearchResult>& candidates,
+                           size_t k, std::vector<SearchResult>& out) {
+    prepare(query);
+    top_.reset(k);
+    for (const SearchResult& c : candidates) {
+        if (c.id < store_->size()) top_.push(c.id, score(c.id));
+    }
+    top_.take(out);
+}
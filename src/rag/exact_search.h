@@ -0,0 +1,66 @@
+#ifndef EXACT_SEARCH_H
+#define EXACT_SEARCH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "hnsw_index.h"
+#include "simd_kernels.h"
+#include "vector_store.h"
+
+// Best k of a stream of scores. The heap is sized once, then every push is
+// O(log k) and a full corpus scan never grows it.
+class TopK {
+public:
+    void reset(size_t k);
+    void push(size_t id, float score);
+
+    // best first, leaves the heap empty
+    void take(std::vector<SearchResult>& out);
+
+private:
+    size_t k_ = 0;
+    std::vector<SearchResult> heap_;   // min-heap, weakest kept result at the front
+};
+
+enum class Metric {
+    Dot,        // normalized f32/f16 embeddings
+    Cosine,     // divides by the stored vector's norm, corrects int8 quantization drift
+};
+
+// Brute-force scoring straight from the mapped store with the SIMD kernels.
+// Exact for small corpora, and used to rescore an HNSW shortlist.
+class ExactSearcher {
+public:
+    bool init(const VectorStore* store, Metric metric);
+
+    // every stored vector
+    void search(const float* query, size_t k, std::vector<SearchResult>& out);
+
+    // only the given candidates, e.g. an HNSW result list
+    void rerank(const float* query, const std::vector<SearchResult>& candidates,
+                size_t k, std::vector<SearchResult>& out);
+
+    // benchmarks swap in other kernel sets, defaults to dotKernels()
+    void setKernels(const DotKernels* kernels) { kernels_ = kernels; }
+    const DotKernels& kernels() const { return *kernels_; }
+
+private:
+    void prepare(const float* query);
+    float score(size_t i);
+    float invNorm(size_t i);
+
+    const VectorStore* store_ = nullptr;
+    const DotKernels* kernels_ = &dotKernels();
+    Metric metric_ = Metric::Dot;
+
+    std::vector<float> invNorms_;   // per stored vector, cosine only, filled in as vectors are scored
+    const float* query_ = nullptr;
+    std::vector<int8_t> queryI8_;
+    std::vector<float> vectorScratch_;  // an f32/f16 vector while its norm is taken
+    float queryScale_ = 1.0f;
+    float queryInvNorm_ = 1.0f;
+    TopK top_;
+};
+
+#endif
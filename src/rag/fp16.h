@@ -0,0 +1,72 @@
+#ifndef FP16_H
+#define FP16_H
+
+#include <cstdint>
+#include <cstring>
+
+// IEEE half precision conversion, round to nearest even
+inline uint16_t fp32ToFp16(float f) {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+
+    const uint32_t sign = (x >> 16) & 0x8000;
+    const uint32_t biased = (x >> 23) & 0xff;
+    uint32_t mant = x & 0x7fffff;
+
+    if (biased == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mant ? 0x200 : 0)); // inf / nan
+    }
+
+    const int32_t exp = static_cast<int32_t>(biased) - 127 + 15;
+    if (exp >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00); // overflow to inf
+    }
+
+    if (exp <= 0) {
+        // subnormal half
+        if (exp < -10) return static_cast<uint16_t>(sign);
+        mant |= 0x800000;
+        const uint32_t shift = static_cast<uint32_t>(14 - exp);
+        uint32_t half = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rem > halfway || (rem == halfway && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exp) << 10) | (mant >> 13);
+    const uint32_t rem = mant & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++; // a carry into the exponent is correct
+    return static_cast<uint16_t>(half);
+}
+
+inline float fp16ToFp32(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t x;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            // renormalize the subnormal
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400)) {
+                mant <<= 1;
+                exp--;
+            }
+            x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+    }
+
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+#endif
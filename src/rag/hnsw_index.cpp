@@ -0,0 +1,81 @@
+#include "hnsw_index.h"
+
+#include <iostream>
+#include <hnswlib/hnswlib.h>
+
+bool HnswIndex::create(int dim, size_t max_elements, size_t M, size_t ef_construction) {
+    shutdown();
+    try {
+        space_ = new hnswlib::InnerProductSpace(dim);
+        index_ = new hnswlib::HierarchicalNSW<float>(space_, max_elements, M, ef_construction);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to create HNSW index: " << e.what() << "\n";
+        shutdown();
+        return false;
+    }
+    dim_ = dim;
+    return true;
+}
+
+bool HnswIndex::add(const float* vec, size_t id) {
+    if (!index_) return false;
+    try {
+        index_->addPoint(vec, id);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to add to HNSW index: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool HnswIndex::save(const std::string& path) {
+    if (!index_) return false;
+    try {
+        index_->saveIndex(path);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to save HNSW index: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool HnswIndex::load(const std::string& path, int dim) {
+    shutdown();
+    try {
+        space_ = new hnswlib::InnerProductSpace(dim);
+        index_ = new hnswlib::HierarchicalNSW<float>(space_, path);
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to load HNSW index " << path << ": " << e.what() << "\n";
+        shutdown();
+        return false;
+    }
+    dim_ = dim;
+    return true;
+}
+
+void HnswIndex::setEf(size_t ef) {
+    if (index_) index_->setEf(ef);
+}
+
+void HnswIndex::search(const float* query, size_t k, std::vector<SearchResult>& out) const {
+    out.clear();
+    if (!index_ || k == 0) return;
+
+    // hnswlib returns a max-heap on distance (1 - inner product), worst first
+    auto heap = index_->searchKnn(query, k);
+    out.resize(heap.size());
+    for (size_t i = heap.size(); i > 0; i--) {
+        out[i - 1] = { heap.top().second, 1.0f - heap.top().first };
+        heap.pop();
+    }
+}
+
+size_t HnswIndex::size() const {
+    return index_ ? index_->getCurrentElementCount() : 0;
+}
+
+void HnswIndex::shutdown() {
+    delete index_; index_ = nullptr;
+    delete space_; space_ = nullptr;
+    dim_ = 0;
+}
@@ -0,0 +1,47 @@
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace hnswlib {
+    template<typename dist_t> class HierarchicalNSW;
+    class InnerProductSpace;
+}
+
+struct SearchResult {
+    size_t id;
+    float score;   // cosine similarity for normalized vectors, higher is closer
+};
+
+// Approximate nearest neighbour index over normalized embeddings (hnswlib, inner product)
+class HnswIndex {
+public:
+    HnswIndex() : space_(nullptr), index_(nullptr), dim_(0) {}
+    ~HnswIndex() { shutdown(); }
+
+    bool create(int dim, size_t max_elements, size_t M = 16, size_t ef_construction = 200);
+    bool add(const float* vec, size_t id);
+
+    bool save(const std::string& path);
+    bool load(const std::string& path, int dim);
+
+    // search breadth, trades recall for latency
+    void setEf(size_t ef);
+
+    // best matches first
+    void search(const float* query, size_t k, std::vector<SearchResult>& out) const;
+
+    size_t size() const;
+    int dim() const { return dim_; }
+
+    void shutdown();
+
+private:
+    hnswlib::InnerProductSpace* space_;
+    hnswlib::HierarchicalNSW<float>* index_;
+    int dim_;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "retriever.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+bool Retriever::init(const RagConfig& config) {
+    config_ = config;
+    std::filesystem::path dir(config.index_dir);
+
+    if (!store_.open((dir / RAG_STORE_FILE).string())) {
+        return false;
+    }
+
+    // scanning a small corpus is exact and about as fast as walking the graph
+    useExact_ = store_.size() <= config.exact_max_chunks;
+    if (!useExact_) {
+        if (!index_.load((dir / RAG_INDEX_FILE).string(), store_.dim())) {
+            return false;
+        }
+        index_.setEf(std::max(config.ef_search, config.rerank_candidates));
+    }
+
+    // int8 vectors lose their unit norm to rounding, so rescale by it
+    exact_.init(&store_, store_.type() == VectorType::I8 ? Metric::Cosine : Metric::Dot);
+
+    if (!embedder_.init(config.embed_model, config.gpu_layers)) {
+        std::cerr << "Failed to load embedding model " << config.embed_model << "\n";
+        return false;
+    }
+
+    if (embedder_.dim() != store_.dim()) {
+        std::cerr << "Embedding model has " << embedder_.dim() << " dimensions, index was built with "
+                  << store_.dim() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool Retriever::retrieve(const std::string& query, std::vector<RetrievedChunk>& out) {
+    out.clear();
+    if (!embedder_.embed(query, query_)) return false;
+
+    if (useExact_) {
+        exact_.search(query_.data(), config_.top_k, hits_);
+    } else if (config_.rerank_candidates > config_.top_k) {
+        index_.search(query_.data(), config_.rerank_candidates, candidates_);
+        exact_.rerank(query_.data(), candidates_, config_.top_k, hits_);
+    } else {
+        index_.search(query_.data(), config_.top_k, hits_);
+    }
+
+    for (const SearchResult& hit : hits_) {
+        if (hit.score < config_.min_score || hit.id >= store_.size()) continue;
+        out.push_back({ hit.id, store_.source(hit.id), store_.text(hit.id), hit.score });
+    }
+    return true;
+}
+
+std::string Retriever::buildContext(const std::string& query) {
+    std::vector<RetrievedChunk> chunks;
+    if (!retrieve(query, chunks) || chunks.empty()) return "";
+
+    std::string context = "Background notes, use them only if they help answer:\n";
+    size_t used = 0;
+    for (const RetrievedChunk& rc : chunks) {
+        if (used > 0 && used + rc.text.size() > config_.max_context_chars) break;
+        context += "- ";
+        context += rc.text;
+        context += "\n";
+        used += rc.text.size();
+    }
+    context += "\n";
+    return context;
+}
+
+std::string Retriever::searchPath() const {
+    std::string kernels = exact_.kernels().name;
+    if (useExact_) return "exact (" + kernels + ")";
+    if (config_.rerank_candidates > config_.top_k) return "hnsw + rerank (" + kernels + ")";
+    return "hnsw";
+}
@@ -0,0 +1,63 @@
+#ifndef RETRIEVER_H
+#define RETRIEVER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "embedder.h"
+#include "exact_search.h"
+#include "hnsw_index.h"
+#include "vector_store.h"
+
+// files inside an index directory, written by jarvis_rag_build
+inline constexpr const char* RAG_INDEX_FILE = "index.hnsw";
+inline constexpr const char* RAG_STORE_FILE = "store.jvs";
+
+struct RagConfig {
+    std::string embed_model;    // GGUF embedding model, must match the one used to build the index
+    std::string index_dir;
+    int gpu_layers = 99;
+    size_t top_k = 3;
+    float min_score = 0.35f;    // drop weak matches instead of padding the prompt with noise
+    size_t ef_search = 64;
+    size_t exact_max_chunks = 20000;    // brute-force scan up to this size, HNSW is not even loaded
+    size_t rerank_candidates = 0;       // HNSW shortlist rescored exactly from the store, 0 to skip
+    size_t max_context_chars = 2000;
+};
+
+// views into the mapped store, valid while the retriever lives
+struct RetrievedChunk {
+    size_t id;
+    std::string_view source;
+    std::string_view text;
+    float score;
+};
+
+class Retriever {
+public:
+    bool init(const RagConfig& config);
+
+    // top_k chunks scoring at least min_score, best first
+    bool retrieve(const std::string& query, std::vector<RetrievedChunk>& out);
+
+    // context block to put in front of the user's message, empty if nothing relevant
+    std::string buildContext(const std::string& query);
+
+    // "exact (avx2)", "hnsw" or "hnsw + rerank (avx2)" for logging
+    std::string searchPath() const;
+
+private:
+    RagConfig config_;
+    Embedder embedder_;
+    HnswIndex index_;
+    VectorStore store_;
+    ExactSearcher exact_;
+    bool useExact_ = false;
+
+    std::vector<float> query_;
+    std::vector<SearchResult> hits_;
+    std::vector<SearchResult> candidates_;
+};
+
+#endif
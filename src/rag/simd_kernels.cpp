@@ -0,0 +1,283 @@
+#include "simd_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "fp16.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC compiles any intrinsic without /arch flags, GCC and Clang need the
+// target enabled per function so the rest of the build stays baseline x86-64
+#if defined(SIMD_KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_AVX2   __attribute__((target("avx2,fma,f16c")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,fma,f16c")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+// --- scalar ---
+
+static float dotF32Scalar(const float* a, const float* b, size_t n) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static float dotF16Scalar(const float* q, const uint16_t* v, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) sum += q[i] * fp16ToFp32(v[i]);
+    return sum;
+}
+
+static int32_t dotI8Scalar(const int8_t* a, const int8_t* b, size_t n) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum;
+}
+
+static const DotKernels SCALAR_KERNELS = { "scalar", dotF32Scalar, dotF16Scalar, dotI8Scalar };
+
+#if defined(SIMD_KERNELS_X86)
+
+// --- AVX2 + FMA + F16C ---
+
+TARGET_AVX2 static float hsum256(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_shuffle_ps(lo, lo, 1));
+    return _mm_cvtss_f32(lo);
+}
+
+TARGET_AVX2 static int32_t hsum256i(__m256i v) {
+    __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(lo);
+}
+
+TARGET_AVX2 static float dotF32Avx2(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    float sum = hsum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+TARGET_AVX2 static float dotF16Avx2(const float* q, const uint16_t* v, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 v0 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+        __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i + 8)));
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(q + i), v0, acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(q + i + 8), v1, acc1);
+    }
+    float sum = hsum256(_mm256_add_ps(acc0, acc1));
+    for (; i < n; i++) sum += q[i] * fp16ToFp32(v[i]);
+    return sum;
+}
+
+TARGET_AVX2 static int32_t dotI8Avx2(const int8_t* a, const int8_t* b, size_t n) {
+    // widen to int16 and let madd pair the products into int32 lanes,
+    // |a*b + c*d| <= 2 * 127 * 128 so nothing saturates
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i a1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)));
+        __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+        acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+        acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+    }
+    int32_t sum = hsum256i(_mm256_add_epi32(acc0, acc1));
+    for (; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum;
+}
+
+static const DotKernels AVX2_KERNELS = { "avx2", dotF32Avx2, dotF16Avx2, dotI8Avx2 };
+
+// --- AVX-512F + BW ---
+
+TARGET_AVX512 static float dotF32Avx512(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i < n; i += 16) {
+        // masked loads cover the tail without a scalar loop
+        __mmask16 m = n - i >= 16 ? static_cast<__mmask16>(0xffff)
+                                  : static_cast<__mmask16>((1u << (n - i)) - 1);
+        acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + i), _mm512_maskz_loadu_ps(m, b + i), acc0);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+TARGET_AVX512 static float dotF16Avx512(const float* q, const uint16_t* v, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 v0 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+        __m512 v1 = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i + 16)));
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(q + i), v0, acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(q + i + 16), v1, acc1);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; i < n; i++) sum += q[i] * fp16ToFp32(v[i]);
+    return sum;
+}
+
+TARGET_AVX512 static int32_t dotI8Avx512(const int8_t* a, const int8_t* b, size_t n) {
+    __m512i acc0 = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m512i b0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m512i a1 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)));
+        __m512i b1 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32)));
+        acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(a0, b0));
+        acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(a1, b1));
+    }
+    int32_t sum = _mm512_reduce_add_epi32(_mm512_add_epi32(acc0, acc1));
+    for (; i < n; i++) sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum;
+}
+
+static const DotKernels AVX512_KERNELS = { "avx512", dotF32Avx512, dotF16Avx512, dotI8Avx512 };
+
+// --- CPU detection ---
+
+struct CpuFeatures {
+    bool avx2 = false;      // includes FMA and F16C
+    bool avx512 = false;    // F and BW
+};
+
+static void cpuid(int leaf, int sub, unsigned regs[4]) {
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuidex(r, leaf, sub);
+    for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned>(r[i]);
+#else
+    __cpuid_count(leaf, sub, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static uint64_t xgetbv0() {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+}
+
+static CpuFeatures detectCpu() {
+    CpuFeatures f;
+    unsigned r[4];
+
+    cpuid(0, 0, r);
+    const unsigned maxLeaf = r[0];
+    if (maxLeaf < 7) return f;
+
+    cpuid(1, 0, r);
+    const bool fma     = (r[2] >> 12) & 1;
+    const bool osxsave = (r[2] >> 27) & 1;
+    const bool avx     = (r[2] >> 28) & 1;
+    const bool f16c    = (r[2] >> 29) & 1;
+    if (!osxsave || !avx) return f;
+
+    // the OS has to save the wider registers on context switch
+    const uint64_t xcr0 = xgetbv0();
+    const bool ymm = (xcr0 & 0x6) == 0x6;
+    const bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    cpuid(7, 0, r);
+    const bool avx2     = (r[1] >> 5) & 1;
+    const bool avx512f  = (r[1] >> 16) & 1;
+    const bool avx512bw = (r[1] >> 30) & 1;
+
+    f.avx2 = ymm && avx2 && fma && f16c;
+    f.avx512 = f.avx2 && zmm && avx512f && avx512bw;
+    return f;
+}
+
+static const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpu();
+    return features;
+}
+
+#endif // SIMD_KERNELS_X86
+
+const DotKernels& dotKernels() {
+#if defined(SIMD_KERNELS_X86)
+    static const DotKernels& best = cpuFeatures().avx512 ? AVX512_KERNELS
+                                  : cpuFeatures().avx2   ? AVX2_KERNELS
+                                                         : SCALAR_KERNELS;
+    return best;
+#else
+    return SCALAR_KERNELS;
+#endif
+}
+
+const DotKernels& scalarDotKernels() {
+    return SCALAR_KERNELS;
+}
+
+size_t availableDotKernels(const DotKernels** out, size_t max) {
+    size_t n = 0;
+    if (n < max) out[n++] = &SCALAR_KERNELS;
+#if defined(SIMD_KERNELS_X86)
+    if (cpuFeatures().avx2 && n < max) out[n++] = &AVX2_KERNELS;
+    if (cpuFeatures().avx512 && n < max) out[n++] = &AVX512_KERNELS;
+#endif
+    return n;
+}
+
+float cosineF32(const float* a, const float* b, size_t n) {
+    const DotKernels& k = dotKernels();
+    const float norms = k.f32(a, a, n) * k.f32(b, b, n);
+    return norms > 0.0f ? k.f32(a, b, n) / std::sqrt(norms) : 0.0f;
+}
+
+float quantizeI8(const float* v, size_t n, int8_t* out) {
+    float maxAbs = 0.0f;
+    for (size_t i = 0; i < n; i++) maxAbs = std::max(maxAbs, std::fabs(v[i]));
+    const float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = static_cast<int8_t>(std::lround(std::clamp(v[i] / scale, -127.0f, 127.0f)));
+    }
+    return scale;
+}
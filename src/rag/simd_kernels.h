@@ -0,0 +1,32 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Dot products over embeddings, one implementation per instruction set.
+// f16 and i8 take the stored vector in its packed form so the search loop
+// never materializes float copies of the corpus.
+struct DotKernels {
+    const char* name;
+    float   (*f32)(const float* a, const float* b, size_t n);
+    float   (*f16)(const float* q, const uint16_t* v, size_t n);
+    int32_t (*i8)(const int8_t* a, const int8_t* b, size_t n);
+};
+
+// best kernels this CPU supports (AVX-512, AVX2 or scalar), resolved once
+const DotKernels& dotKernels();
+
+// portable reference kernels
+const DotKernels& scalarDotKernels();
+
+// every kernel set this CPU can run, scalar first, for benchmarks
+size_t availableDotKernels(const DotKernels** out, size_t max);
+
+// cosine similarity of two float vectors
+float cosineF32(const float* a, const float* b, size_t n);
+
+// symmetric int8 quantization matching VectorStore, returns the scale
+float quantizeI8(const float* v, size_t n, int8_t* out);
+
+#endif
@@ -0,0 +1,256 @@
+#include "vector_store.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "fp16.h"
+
+static constexpr uint32_t VECTOR_STORE_MAGIC = 0x3153564a; // "JVS1"
+static constexpr uint32_t VECTOR_STORE_VERSION = 1;
+static constexpr uint64_t SECTION_ALIGN = 64;
+
+static uint64_t alignUp(uint64_t v) {
+    return (v + SECTION_ALIGN - 1) & ~(SECTION_ALIGN - 1);
+}
+
+static size_t elementSize(VectorType type) {
+    switch (type) {
+        case VectorType::F32: return 4;
+        case VectorType::F16: return 2;
+        case VectorType::I8:  return 1;
+    }
+    return 0;
+}
+
+static void pad(std::ofstream& out, uint64_t target) {
+    static const char zeros[SECTION_ALIGN] = {};
+    uint64_t pos = static_cast<uint64_t>(out.tellp());
+    while (pos < target) {
+        uint64_t n = std::min<uint64_t>(target - pos, SECTION_ALIGN);
+        out.write(zeros, static_cast<std::streamsize>(n));
+        pos += n;
+    }
+}
+
+bool VectorStore::write(const std::string& path, int dim, VectorType type,
+                        const std::vector<Chunk>& chunks, const std::vector<float>& vectors) {
+    const uint64_t count = chunks.size();
+    if (vectors.size() != count * dim) {
+        std::cerr << "Vector count does not match chunk count\n";
+        return false;
+    }
+
+    VectorStoreHeader h{};
+    h.magic = VECTOR_STORE_MAGIC;
+    h.version = VECTOR_STORE_VERSION;
+    h.type = static_cast<uint32_t>(type);
+    h.dim = static_cast<uint32_t>(dim);
+    h.count = count;
+    h.stride = alignUp(elementSize(type) * dim);
+    h.vectors_offset = alignUp(sizeof(h));
+    h.scales_offset = type == VectorType::I8 ? alignUp(h.vectors_offset + h.stride * count) : 0;
+    h.offsets_offset = alignUp(h.scales_offset ? h.scales_offset + count * sizeof(float)
+                                               : h.vectors_offset + h.stride * count);
+    h.text_offset = alignUp(h.offsets_offset + (2 * count + 1) * sizeof(uint64_t));
+
+    std::vector<uint64_t> offsets;
+    offsets.reserve(2 * count + 1);
+    uint64_t textSize = 0;
+    for (const Chunk& c : chunks) {
+        offsets.push_back(textSize);
+        textSize += c.source.size();
+        offsets.push_back(textSize);
+        textSize += c.text.size();
+    }
+    offsets.push_back(textSize);
+    h.text_size = textSize;
+
+    // write to a temp file and rename so readers never map a torn store
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to write " << tmp << "\n";
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    std::vector<uint8_t> row(h.stride);
+    std::vector<float> scales;
+    for (uint64_t i = 0; i < count; i++) {
+        const float* v = vectors.data() + i * dim;
+        std::fill(row.begin(), row.end(), 0);
+
+        if (type == VectorType::F32) {
+            memcpy(row.data(), v, dim * sizeof(float));
+        } else if (type == VectorType::F16) {
+            uint16_t* dst = reinterpret_cast<uint16_t*>(row.data());
+            for (int d = 0; d < dim; d++) dst[d] = fp32ToFp16(v[d]);
+        } else {
+            float maxAbs = 0.0f;
+            for (int d = 0; d < dim; d++) maxAbs = std::max(maxAbs, std::fabs(v[d]));
+            float scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+            int8_t* dst = reinterpret_cast<int8_t*>(row.data());
+            for (int d = 0; d < dim; d++) {
+                dst[d] = static_cast<int8_t>(std::lround(std::clamp(v[d] / scale, -127.0f, 127.0f)));
+            }
+            scales.push_back(scale);
+        }
+
+        pad(out, h.vectors_offset + i * h.stride);
+        out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+
+    if (h.scales_offset) {
+        pad(out, h.scales_offset);
+        out.write(reinterpret_cast<const char*>(scales.data()), static_cast<std::streamsize>(scales.size() * sizeof(float)));
+    }
+
+    pad(out, h.offsets_offset);
+    out.write(reinterpret_cast<const char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint64_t)));
+
+    pad(out, h.text_offset);
+    for (const Chunk& c : chunks) {
+        out.write(c.source.data(), static_cast<std::streamsize>(c.source.size()));
+        out.write(c.text.data(), static_cast<std::streamsize>(c.text.size()));
+    }
+
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write " << tmp << "\n";
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Failed to move " << tmp << " to " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// n elements of elem bytes from offset stay inside size bytes; divides
+// instead of multiplying so a crafted header cannot wrap around
+static bool fits(uint64_t offset, uint64_t n, uint64_t elem, uint64_t size) {
+    return offset <= size && n <= (size - offset) / elem;
+}
+
+bool VectorStore::open(const std::string& path) {
+    close();
+
+    if (!file_.open(path)) {
+        std::cerr << "Failed to map " << path << "\n";
+        return false;
+    }
+
+    const uint8_t* base = file_.data();
+    const uint64_t size = file_.size();
+
+    VectorStoreHeader h;
+    if (size < sizeof(h)) {
+        std::cerr << "Not a vector store: " << path << "\n";
+        close();
+        return false;
+    }
+    memcpy(&h, base, sizeof(h));
+
+    const VectorType type = static_cast<VectorType>(h.type);
+    const bool valid =
+        h.magic == VECTOR_STORE_MAGIC &&
+        h.version == VECTOR_STORE_VERSION &&
+        h.type <= static_cast<uint32_t>(VectorType::I8) &&
+        h.dim > 0 &&
+        h.stride >= elementSize(type) * h.dim &&
+        // the kernels load rows with aligned 64 byte accesses
+        h.stride % SECTION_ALIGN == 0 &&
+        h.vectors_offset % SECTION_ALIGN == 0 &&
+        h.scales_offset % SECTION_ALIGN == 0 &&
+        h.offsets_offset % SECTION_ALIGN == 0 &&
+        h.text_offset % SECTION_ALIGN == 0 &&
+        // count <= size once the vectors fit, so 2 * count + 1 cannot wrap below
+        fits(h.vectors_offset, h.count, h.stride, size) &&
+        (h.scales_offset == 0) == (type != VectorType::I8) &&
+        fits(h.scales_offset, h.count, sizeof(float), size) &&
+        fits(h.offsets_offset, 2 * h.count + 1, sizeof(uint64_t), size) &&
+        fits(h.text_offset, h.text_size, 1, size);
+
+    if (!valid) {
+        std::cerr << "Corrupt or incompatible vector store: " << path << "\n";
+        close();
+        return false;
+    }
+
+    // every text view must stay inside the text section, not just the last;
+    // one sequential pass over 16 bytes per chunk
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + h.offsets_offset);
+    bool ordered = true;
+    for (uint64_t i = 0; i < 2 * h.count && ordered; i++) {
+        ordered = offsets[i] <= offsets[i + 1];
+    }
+    if (!ordered || offsets[2 * h.count] != h.text_size) {
+        std::cerr << "Corrupt text offsets in " << path << "\n";
+        close();
+        return false;
+    }
+
+    type_ = type;
+    dim_ = static_cast<int>(h.dim);
+    count_ = static_cast<size_t>(h.count);
+    stride_ = static_cast<size_t>(h.stride);
+    vectors_ = base + h.vectors_offset;
+    scales_ = h.scales_offset ? reinterpret_cast<const float*>(base + h.scales_offset) : nullptr;
+    offsets_ = offsets;
+    text_ = reinterpret_cast<const char*>(base + h.text_offset);
+    return true;
+}
+
+void VectorStore::close() {
+    file_.close();
+    count_ = 0;
+    dim_ = 0;
+    vectors_ = nullptr;
+    scales_ = nullptr;
+    offsets_ = nullptr;
+    text_ = nullptr;
+}
+
+void VectorStore::vector(size_t i, float* out) const {
+    const void* data = vectorData(i);
+    switch (type_) {
+        case VectorType::F32:
+            memcpy(out, data, dim_ * sizeof(float));
+            break;
+        case VectorType::F16: {
+            const uint16_t* v = static_cast<const uint16_t*>(data);
+            for (int d = 0; d < dim_; d++) out[d] = fp16ToFp32(v[d]);
+            break;
+        }
+        case VectorType::I8: {
+            const int8_t* v = static_cast<const int8_t*>(data);
+            const float s = scale(i);
+            for (int d = 0; d < dim_; d++) out[d] = v[d] * s;
+            break;
+        }
+    }
+}
+
+const char* VectorStore::typeName(VectorType type) {
+    switch (type) {
+        case VectorType::F32: return "f32";
+        case VectorType::F16: return "f16";
+        case VectorType::I8:  return "i8";
+    }
+    return "?";
+}
+
+bool VectorStore::parseType(const std::string& name, VectorType& out) {
+    if (name == "f32") { out = VectorType::F32; return true; }
+    if (name == "f16") { out = VectorType::F16; return true; }
+    if (name == "i8")  { out = VectorType::I8;  return true; }
+    return false;
+}
@@ -0,0 +1,83 @@
+#ifndef VECTOR_STORE_H
+#define VECTOR_STORE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "../util/mapped_file.h"
+
+enum class VectorType : uint32_t {
+    F32 = 0,
+    F16 = 1,
+    I8  = 2,    // symmetric, one float scale per vector
+};
+
+// On-disk layout, every section starts on a 64 byte boundary:
+//   header
+//   vectors      count * stride bytes, each vector padded to 64 bytes
+//   scales       count floats, int8 stores only
+//   offsets      2 * count + 1 uint64, source i spans [2i, 2i+1), text i spans [2i+1, 2i+2)
+//   text arena   UTF-8, no terminators
+struct VectorStoreHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t type;
+    uint32_t dim;
+    uint64_t count;
+    uint64_t stride;
+    uint64_t vectors_offset;
+    uint64_t scales_offset;
+    uint64_t offsets_offset;
+    uint64_t text_offset;
+    uint64_t text_size;
+};
+
+// Chunk text and embeddings of a RAG index, memory-mapped read-only. Opening
+// only validates the header and offset table; nothing is copied to the heap and
+// the page cache is shared between processes using the same store.
+class VectorStore {
+public:
+    static bool write(const std::string& path, int dim, VectorType type,
+                      const std::vector<Chunk>& chunks, const std::vector<float>& vectors);
+
+    bool open(const std::string& path);
+    void close();
+
+    size_t size() const { return count_; }
+    int dim() const { return dim_; }
+    VectorType type() const { return type_; }
+
+    std::string_view source(size_t i) const { return arena(2 * i); }
+    std::string_view text(size_t i) const { return arena(2 * i + 1); }
+
+    // raw element data of vector i, 64 byte aligned
+    const void* vectorData(size_t i) const { return vectors_ + i * stride_; }
+    // dequantization scale of vector i, 1 for float stores
+    float scale(size_t i) const { return scales_ ? scales_[i] : 1.0f; }
+
+    // vector i converted to float
+    void vector(size_t i, float* out) const;
+
+    static const char* typeName(VectorType type);
+    static bool parseType(const std::string& name, VectorType& out);
+
+private:
+    std::string_view arena(size_t slot) const {
+        return std::string_view(text_ + offsets_[slot], offsets_[slot + 1] - offsets_[slot]);
+    }
+
+    MappedFile file_;
+    VectorType type_ = VectorType::F32;
+    int dim_ = 0;
+    size_t count_ = 0;
+    size_t stride_ = 0;
+    const uint8_t* vectors_ = nullptr;
+    const float* scales_ = nullptr;
+    const uint64_t* offsets_ = nullptr;
+    const char* text_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "local_socket.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+// WSAStartup once per process, before the first socket
+static bool startSockets() {
+    static const bool started = [] {
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }();
+    return started;
+}
+
+static void closeHandle(uintptr_t handle) { closesocket(static_cast<SOCKET>(handle)); }
+static const int SHUTDOWN_BOTH = SD_BOTH;
+static const int SEND_FLAGS = 0;
+
+#else
+
+static bool startSockets() { return true; }
+static void closeHandle(int handle) { ::close(handle); }
+static const int SHUTDOWN_BOTH = SHUT_RDWR;
+static const int SEND_FLAGS = MSG_NOSIGNAL;   // a client that went away is an error, not SIGPIPE
+
+#endif
+
+static sockaddr_in loopbackAddress(uint16_t port) {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+// streamed tokens are small writes, send them as they come
+static void setNoDelay(uintptr_t handle) {
+    int on = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&on), sizeof(on));
+}
+
+bool LocalSocket::listen(uint16_t port, int backlog) {
+    close();
+    if (!startSockets()) return false;
+
+    Handle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == INVALID) return false;
+
+    int on = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&on), sizeof(on));
+
+    sockaddr_in addr = loopbackAddress(port);
+    if (bind(handle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(handle, backlog) != 0) {
+        fprintf(stderr, "cannot listen on 127.0.0.1:%u\n", static_cast<unsigned>(port));
+        closeHandle(handle);
+        return false;
+    }
+
+    handle_ = handle;
+    return true;
+}
+
+bool LocalSocket::connect(uint16_t port) {
+    close();
+    if (!startSockets()) return false;
+
+    Handle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == INVALID) return false;
+
+    sockaddr_in addr = loopbackAddress(port);
+    if (::connect(handle, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        closeHandle(handle);
+        return false;
+    }
+
+    setNoDelay(static_cast<uintptr_t>(handle));
+    handle_ = handle;
+    return true;
+}
+
+bool LocalSocket::accept(LocalSocket& client) {
+    client.close();
+    if (handle_ == INVALID) return false;
+
+    Handle handle = ::accept(handle_, nullptr, nullptr);
+    if (handle == INVALID) return false;
+
+    setNoDelay(static_cast<uintptr_t>(handle));
+    client.handle_ = handle;
+    return true;
+}
+
+bool LocalSocket::send(std::string_view data) {
+    while (!data.empty()) {
+        int chunk = static_cast<int>(std::min<size_t>(data.size(), 1 << 20));
+        int sent = ::send(handle_, data.data(), chunk, SEND_FLAGS);
+        if (sent <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+bool LocalSocket::readLine(std::string& line) {
+    size_t scanned = 0;
+    while (true) {
+        size_t end = pending_.find('\n', scanned);
+        if (end != std::string::npos) {
+            line.assign(pending_, 0, end);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            pending_.erase(0, end + 1);
+            return true;
+        }
+        scanned = pending_.size();
+
+        char buf[4096];
+        int got = ::recv(handle_, buf, sizeof(buf), 0);
+        if (got <= 0) return false;
+        pending_.append(buf, static_cast<size_t>(got));
+    }
+}
+
+void LocalSocket::shutdown() {
+    if (handle_ != INVALID) ::shutdown(handle_, SHUTDOWN_BOTH);
+}
+
+void LocalSocket::close() {
+    if (handle_ != INVALID) {
+        closeHandle(handle_);
+        handle_ = INVALID;
+    }
+    pending_.clear();
+}
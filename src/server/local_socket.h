@@ -0,0 +1,50 @@
+#ifndef LOCAL_SOCKET_H
+#define LOCAL_SOCKET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Blocking TCP socket bound to the loopback interface, just enough for the
+// session server and its load generator. Lines end in '\n'.
+class LocalSocket {
+public:
+    LocalSocket() = default;
+    ~LocalSocket() { close(); }
+
+    LocalSocket(const LocalSocket&) = delete;
+    LocalSocket& operator=(const LocalSocket&) = delete;
+
+    // 127.0.0.1 only, the server is not meant to be reachable from outside
+    bool listen(uint16_t port, int backlog = 16);
+    bool connect(uint16_t port);
+
+    // blocks for the next client, false once the listener is shut down
+    bool accept(LocalSocket& client);
+
+    bool send(std::string_view data);
+
+    // the next line without its '\n', false on end of stream or error
+    bool readLine(std::string& line);
+
+    // wakes a thread blocked in accept() or readLine(), any thread
+    void shutdown();
+    void close();
+
+    bool isOpen() const { return handle_ != INVALID; }
+
+private:
+#ifdef _WIN32
+    using Handle = uintptr_t;
+    static constexpr Handle INVALID = ~static_cast<Handle>(0);
+#else
+    using Handle = int;
+    static constexpr Handle INVALID = -1;
+#endif
+    Handle handle_ = INVALID;
+
+    std::string pending_;   // received past the last line handed out
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "session_server.h"
+
+#include <condition_variable>
+#include <cstdio>
+
+#include "../util/cancel_token.h"
+
+// replies go out one per line
+static void appendEscaped(std::string& out, std::string_view text) {
+    for (char c : text) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            default:   out += c; break;
+        }
+    }
+}
+
+// Prompts are tokenized with control tokens parsed, so a client must not be
+// able to open or close turns of its own: "<|" loses its meaning.
+static std::string plainText(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    for (size_t i = 0; i < text.size(); i++) {
+        out += text[i];
+        if (text[i] == '<' && i + 1 < text.size() && text[i + 1] == '|') out += ' ';
+    }
+    return out;
+}
+
+bool SessionServer::start(const SessionServerConfig& config) {
+    config_ = config;
+    if (!listener_.listen(config.port)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+    return true;
+}
+
+void SessionServer::run() {
+    while (true) {
+        Connection* connection = new Connection();
+        if (!listener_.accept(connection->socket)) {
+            delete connection;
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            delete connection;
+            break;
+        }
+
+        // reap clients that have left
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if ((*it)->finished) {
+                (*it)->thread.join();
+                delete *it;
+                it = connections_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        connections_.push_back(connection);
+        connection->thread = std::thread(&SessionServer::serve, this, connection);
+    }
+
+    stop();
+
+    std::vector<Connection*> connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.swap(connections_);
+    }
+    for (Connection* connection : connections) {
+        connection->thread.join();
+        delete connection;
+    }
+}
+
+void SessionServer::stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    listener_.shutdown();
+    // wakes every client thread out of readLine()
+    for (Connection* connection : connections_) {
+        connection->socket.shutdown();
+    }
+}
+
+void SessionServer::serve(Connection* connection) {
+    LocalSocket& socket = connection->socket;
+
+    int session = llm_.openSession();
+    if (session < 0) {
+        socket.send("E server full\n");
+    } else if (socket.send("S " + std::to_string(session) + "\n")) {
+        std::string line;
+        while (socket.readLine(line)) {
+            if (line.empty()) continue;
+            if (line == "/quit") break;
+
+            if (line == "/reset") {
+                if (!socket.send(llm_.clearHistory(session) ? "O\n" : "E busy\n")) break;
+                continue;
+            }
+
+            if (line == "/voice" || line == "/text") {
+                SessionPriority priority = line == "/voice" ? SessionPriority::Voice : SessionPriority::Text;
+                if (!socket.send(llm_.setPriority(session, priority) ? "O\n" : "E unknown session\n")) break;
+                continue;
+            }
+
+            if (line == "/stats") {
+                if (!socket.send(statsLine())) break;
+                continue;
+            }
+
+            if (!reply(socket, session, line)) break;
+        }
+        llm_.closeSession(session);
+    }
+
+    // closed when run() reaps the connection, stop() may still shut it down
+    std::lock_guard<std::mutex> lock(mutex_);
+    socket.shutdown();
+    connection->finished = true;
+}
+
+// Pieces arrive on the decode thread and are only queued there; this
+// thread does the sending, so a slow client never stalls the batch.
+bool SessionServer::reply(LocalSocket& socket, int session, const std::string& message) {
+    std::string prompt =
+        "<|im_start|>user\n" +
+        plainText(message) +
+        "\n<|im_end|>\n"
+        "<|im_start|>assistant\n";
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string pending = "R ";
+    bool done = false;
+    ReplyStats stats;
+    CancelToken cancel;
+
+    bool submitted = llm_.submit(session, prompt, config_.max_tokens,
+        [&](std::string_view piece) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                appendEscaped(pending, piece);
+            }
+            cv.notify_one();
+        },
+        [&](const ReplyStats& result) {
+            // notified under the lock, the frame goes away as soon as done is seen
+            std::lock_guard<std::mutex> lock(mutex);
+            stats = result;
+            done = true;
+            cv.notify_one();
+        },
+        &cancel);
+
+    if (!submitted) return socket.send("E busy\n");
+
+    // a client that went away still has to wait for on_done, it refers to this frame
+    bool connected = true;
+    std::string out;
+    while (true) {
+        bool finished;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return done || !pending.empty(); });
+            out.swap(pending);
+            pending.clear();
+            finished = done;
+        }
+        if (connected && !out.empty() && !socket.send(out)) {
+            connected = false;
+            cancel.cancel();
+        }
+        if (finished) break;
+    }
+    if (!connected) return false;
+
+    if (stats.failed) return socket.send("\nE reply failed\n");
+
+    char line[160];
+    snprintf(line, sizeof(line), "\nD tokens=%d prompt=%d queue_ms=%.1f ttft_ms=%.1f total_ms=%.1f\n",
+             stats.n_tokens, stats.n_prompt, stats.queue_ms, stats.ttft_ms, stats.total_ms);
+
+    if (config_.log_replies) {
+        BatchStats batch = llm_.stats();
+        printf("[session %d: %d tokens, ttft %.0f ms, %.0f ms total%s | mean batch %.1f, %.0f tok/s, "
+               "%d waiting, voice gap %.0f/%.0f ms]\n",
+               session, stats.n_tokens, stats.ttft_ms, stats.total_ms, stats.cancelled ? ", cancelled" : "",
+               batch.meanBatch(), batch.tokensPerSecond(), batch.waiting,
+               batch.voice.meanGapMs(), batch.voice.max_gap_ms);
+        fflush(stdout);
+    }
+    return socket.send(line);
+}
+
+// "M steps=.. mean_batch=.. ... voice_ttft_ms=.. text_gap_ms=.." on one line
+std::string SessionServer::statsLine() const {
+    const BatchStats batch = llm_.stats();
+
+    char line[640];
+    int n = snprintf(line, sizeof(line),
+                     "M steps=%llu prefill_steps=%llu mean_batch=%.1f step_ms=%.1f max_step_ms=%.1f "
+                     "decode_tok_s=%.1f tok_s=%.1f replies=%llu waiting=%d generating=%d",
+                     static_cast<unsigned long long>(batch.steps), static_cast<unsigned long long>(batch.prefill_steps),
+                     batch.meanBatch(), batch.meanStepMs(), batch.max_step_ms,
+                     batch.tokensPerSecond(), batch.throughput(), static_cast<unsigned long long>(batch.replies),
+                     batch.waiting, batch.generating);
+
+    const std::pair<const char*, const PriorityStats*> classes[] = { { "voice", &batch.voice }, { "text", &batch.text } };
+    for (const auto& [name, c] : classes) {
+        if (n < 0 || n >= static_cast<int>(sizeof(line))) break;
+        n += snprintf(line + n, sizeof(line) - n,
+                      " %s_replies=%llu %s_queue_ms=%.1f %s_ttft_ms=%.1f %s_max_ttft_ms=%.1f %s_gap_ms=%.1f %s_max_gap_ms=%.1f",
+                      name, static_cast<unsigned long long>(c->replies), name, c->meanQueueMs(),
+                      name, c->meanTtftMs(), name, c->max_ttft_ms, name, c->meanGapMs(), name, c->max_gap_ms);
+    }
+    return std::string(line) + "\n";
+}
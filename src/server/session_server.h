@@ -0,0 +1,64 @@
+#ifndef SESSION_SERVER_H
+#define SESSION_SERVER_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "local_socket.h"
+#include "../llm/batched_inference.h"
+
+struct SessionServerConfig {
+    uint16_t port = 8765;
+    int max_tokens = 512;       // per reply
+    bool log_replies = true;    // one line per reply on stdout
+};
+
+// Text chat over loopback TCP, one conversation per connection, all of them
+// served by one BatchedInference. Line protocol, UTF-8:
+//
+//   server: S <session>              on connect, or "E server full" and close
+//   client: <message>                one user turn per line
+//   server: R <reply>                streamed as it is generated, \n and \\ escaped
+//           D tokens=<n> prompt=<n> queue_ms=<x> ttft_ms=<x> total_ms=<x>
+//   client: /reset                   forget the conversation, server: O
+//   client: /voice, /text            priority of the next replies, server: O
+//   client: /stats                   server: M <key>=<value> ... for the whole batch
+//   client: /quit                    close
+//   server: E <message>              the turn was refused
+class SessionServer {
+public:
+    explicit SessionServer(BatchedInference& llm) : llm_(llm) {}
+    ~SessionServer() { stop(); }
+
+    bool start(const SessionServerConfig& config);
+
+    // accepts clients until stop(), then waits for their threads
+    void run();
+
+    // any thread
+    void stop();
+
+private:
+    struct Connection {
+        LocalSocket socket;
+        std::thread thread;
+        bool finished = false;
+    };
+
+    void serve(Connection* connection);
+    bool reply(LocalSocket& socket, int session, const std::string& message);
+    std::string statsLine() const;
+
+    BatchedInference& llm_;
+    SessionServerConfig config_;
+    LocalSocket listener_;
+
+    std::mutex mutex_;
+    std::vector<Connection*> connections_;
+    bool stopping_ = false;
+};
+
+#endif
@@ -5,8 +5,10 @@
 #include <atomic>
 #include <mutex>
 #include <string>
+#include <algorithm>
 
 #include "transcribe.h"
+#include "../util/trace.h"
 #include <whisper.h>
 
 bool Transcribe::init(const std::string &model_path) {
@@ -14,9 +16,10 @@ bool Transcribe::init(const std::string &model_path) {
         system("chcp 65001");
     #endif
         //=== 1. Initialize Whisper ===
-        std::cout << "Loading Whisper model...\n";
-
-        std::cout << "Whisper system info: " << whisper_print_system_info() << "\n";
+        if (!quiet_) {
+            std::cerr << "Loading Whisper model...\n";
+            std::cerr << "Whisper system info: " << whisper_print_system_info() << "\n";
+        }
 
         const std::string& model = model_path;
 
@@ -35,17 +38,13 @@ bool Transcribe::init(const std::string &model_path) {
             std::cerr << "Make sure ggml-base.en.bin exists in models/ folder\n";
             return false;
         }
-        std::cout << "Model loaded successfully!\n";
+        if (!quiet_) std::cerr << "Model loaded successfully!\n";
         return true;
 }
 
-std::string Transcribe::transcribe(const std::vector<float> &audio) {
-    if (audio.size() < 1600) {
-        return "Not enough audio captured (need at least 0.1 seconds)\n";
-    }
-
-    std::cout << "Transcribing...\n";
-
+bool Transcribe::decode(const float* samples, size_t n, const std::string& prompt, std::vector<Segment>& out,
+                        bool partial) {
+    TRACE_SCOPE("whisper");
     whisper_full_params full_params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
     full_params.print_progress   = false;
     full_params.print_timestamps = false;
@@ -56,27 +55,216 @@ std::string Transcribe::transcribe(const std::vector<float> &audio) {
     full_params.vad = false;
     full_params.vad_model_path = "models/silero-v6.2.0-ggml.bin";
 
+    // Whisper pads everything to 30s and by default encodes all of it. The
+    // encoder only runs over the frames that hold audio (50 per second, plus
+    // a margin, rounded up), so a 2s tail costs a fraction of a full pass.
+    int frames = static_cast<int>(n * 50 / SAMPLE_RATE) + 64;
+    full_params.audio_ctx = std::clamp((frames + 63) / 64 * 64, AUDIO_CTX_MIN, AUDIO_CTX_FULL);
+
+    // a sliding-window decode still running when speech ends is given up,
+    // the final decode of the tail replaces it anyway
+    if (partial) {
+        full_params.abort_callback = [](void* data) {
+            return static_cast<std::atomic<bool>*>(data)->load(std::memory_order_relaxed);
+        };
+        full_params.abort_callback_user_data = &abortPartial_;
+    }
+
+    // windows overlap, so never carry decoder state between calls
+    full_params.no_context = true;
+    if (!prompt.empty()) {
+        full_params.initial_prompt = prompt.c_str();
+    }
+
+    std::lock_guard<std::mutex> lock(whisperMutex_);
+
     // Run inference
-    if (whisper_full(ctx_, full_params, audio.data(), static_cast<int>(audio.size())) != 0) {
-        return "Whisper inference failed!\n";
+    auto start = std::chrono::steady_clock::now();
+    int result = whisper_full(ctx_, full_params, samples, static_cast<int>(n));
+    whisperSeconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (result != 0) {
+        return false;
     }
 
-    // Get the transcribed text
+    out.clear();
     int numSegments = whisper_full_n_segments(ctx_);
-    std::cout << "\n\n=== Transcription ===\n\n";
+    for (int i = 0; i < numSegments; i++) {
+        // timestamps are in 10ms units
+        int64_t end = whisper_full_get_segment_t1(ctx_, i) * static_cast<int64_t>(SAMPLE_RATE / 100);
+        out.push_back({ whisper_full_get_segment_text(ctx_, i), std::min<int64_t>(end, n) });
+    }
+    return true;
+}
 
+std::string Transcribe::transcribe(std::span<const float> audio) {
+    if (audio.size() < MIN_SAMPLES) {
+        return "Not enough audio captured (need at least 0.1 seconds)\n";
+    }
+
+    if (!quiet_) std::cerr << "Transcribing...\n";
+
+    std::vector<Segment> segments;
+    if (!decode(audio.data(), audio.size(), "", segments)) {
+        return "Whisper inference failed!\n";
+    }
+
+    // Get the transcribed text
     std::string fullText;
-    for (int i = 0; i < numSegments; i++) {
-        const char* text = whisper_full_get_segment_text(ctx_, i);
-        fullText += text;
-        std::cout << text;
+    for (const Segment& seg : segments) {
+        fullText += seg.text;
     }
-    std::cout << "\n=====================\n";
+    printTranscript(fullText);
+
+    return fullText;
+}
+
+void Transcribe::printTranscript(const std::string& text) const {
+    if (quiet_) return;
+    std::cerr << "\n\n=== Transcription ===\n\n";
+    std::cerr << text;
+    std::cerr << "\n=====================\n";
+}
+
+void Transcribe::warmup() {
+    std::vector<float> silence(SAMPLE_RATE, 0.0f);
+    std::vector<Segment> segments;
+    decode(silence.data(), silence.size(), "", segments);
+}
+
+void Transcribe::beginStream() {
+    if (streamThread_.joinable()) {
+        finishStream();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(streamMutex_);
+        streamAudio_ = {};
+        committedSamples_ = 0;
+        decodedSamples_ = 0;
+        committedText_.clear();
+        streaming_ = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(whisperMutex_);
+        whisperSeconds_ = 0.0;
+    }
+
+    streamThread_ = std::thread(&Transcribe::streamLoop, this);
+}
+
+void Transcribe::feedStream(std::span<const float> utterance) {
+    {
+        std::lock_guard<std::mutex> lock(streamMutex_);
+        if (!streaming_ || utterance.size() <= streamAudio_.size()) return;
+        streamAudio_ = utterance;
+    }
+    streamCv_.notify_one();
+}
+
+void Transcribe::streamLoop() {
+    TRACE_THREAD_NAME("stt stream");
+    std::span<const float> window;
+    std::vector<Segment> segments;
+
+    while (true) {
+        size_t windowStart;
+        std::string prompt;
+        {
+            std::unique_lock<std::mutex> lock(streamMutex_);
+            streamCv_.wait(lock, [this] {
+                return !streaming_ || streamAudio_.size() - decodedSamples_ >= STREAM_STEP;
+            });
+            if (!streaming_) break;
+
+            // decoded in place, capture only ever appends after it
+            windowStart = committedSamples_;
+            window = streamAudio_.subspan(windowStart);
+            decodedSamples_ = streamAudio_.size();
+
+            size_t promptStart = committedText_.size() > PROMPT_CHARS ? committedText_.size() - PROMPT_CHARS : 0;
+            prompt = committedText_.substr(promptStart);
+        }
+
+        if (!decode(window.data(), window.size(), prompt, segments, true) || segments.empty()) {
+            continue;
+        }
+
+        // Commit every segment that ends well before the window edge. The last
+        // segment is always kept open since whisper may still extend or rewrite it,
+        // unless the window is about to outgrow whisper's input.
+        bool forceCommit = window.size() >= MAX_WINDOW;
+        size_t stableEnd = window.size() > STABLE_MARGIN ? window.size() - STABLE_MARGIN : 0;
+
+        std::string newText;
+        int64_t newCommitted = 0;
+        for (size_t i = 0; i < segments.size(); i++) {
+            bool last = (i + 1 == segments.size());
+            bool stable = !last && static_cast<size_t>(segments[i].endSample) <= stableEnd;
+            if (!stable && !(forceCommit && (!last || segments.size() == 1))) break;
+            newText += segments[i].text;
+            newCommitted = segments[i].endSample;
+        }
+
+        if (newCommitted > 0) {
+            std::lock_guard<std::mutex> lock(streamMutex_);
+            committedText_ += newText;
+            committedSamples_ = windowStart + static_cast<size_t>(newCommitted);
+        }
+    }
+}
+
+std::string Transcribe::finishStream() {
+    {
+        std::lock_guard<std::mutex> lock(streamMutex_);
+        streaming_ = false;
+    }
+    streamCv_.notify_one();
+
+    // don't wait for a window decode to run its course, the tail below
+    // covers everything it would have committed
+    abortPartial_ = true;
+    if (streamThread_.joinable()) {
+        streamThread_.join();
+    }
+    abortPartial_ = false;
+
+    if (streamAudio_.size() < MIN_SAMPLES) {
+        return "Not enough audio captured (need at least 0.1 seconds)\n";
+    }
+
+    if (!quiet_) std::cerr << "Transcribing...\n";
+
+    // only the tail after the last committed segment still needs decoding
+    std::string fullText = committedText_;
+    size_t tail = streamAudio_.size() - committedSamples_;
+    if (tail >= MIN_SAMPLES) {
+        size_t promptStart = committedText_.size() > PROMPT_CHARS ? committedText_.size() - PROMPT_CHARS : 0;
+        std::vector<Segment> segments;
+        if (!decode(streamAudio_.data() + committedSamples_, tail, committedText_.substr(promptStart), segments)) {
+            return "Whisper inference failed!\n";
+        }
+        for (const Segment& seg : segments) {
+            fullText += seg.text;
+        }
+    }
+
+    printTranscript(fullText);
 
     return fullText;
 }
 
 void Transcribe::shutdown() {
+    if (streamThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(streamMutex_);
+            streaming_ = false;
+        }
+        streamCv_.notify_one();
+        abortPartial_ = true;
+        streamThread_.join();
+        abortPartial_ = false;
+    }
+
     if (ctx_) {
         whisper_free(ctx_);
         ctx_ = nullptr;
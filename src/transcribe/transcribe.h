@@ -1,8 +1,14 @@
 #ifndef TRANSCRIBE_H
 #define TRANSCRIBE_H
 
+#include <atomic>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <cstdint>
+#include <span>
 #include <whisper.h>
 
 class Transcribe {
@@ -15,12 +21,71 @@ public:
         shutdown();
     }
 
+    // no banners or transcripts on the console, for tools that print reports;
+    // either way they go to stderr, never into stdout
+    void setQuiet(bool quiet) { quiet_ = quiet; }
+
     bool init(const std::string& model_path);
-    std::string transcribe(const std::vector<float> &audio);
+    std::string transcribe(std::span<const float> audio);
+
+    // one throwaway decode so the first real utterance does not pay for
+    // backend setup and kernel compilation
+    void warmup();
+
+    // streaming: decode sliding windows while audio is still being captured.
+    // segments that stop changing are committed, so finishStream() only has
+    // to re-decode the unstable tail after the last committed segment.
+    // feedStream() gets the whole utterance so far each time, the same
+    // samples growing at the end; they are read in place and must stay put
+    // until finishStream() returns.
+    void beginStream();
+    void feedStream(std::span<const float> utterance);
+    std::string finishStream();
+
+    // the last stream's length and the whisper time it took, valid once
+    // finishStream() returned; the caller books them to its turn
+    double streamAudioSeconds() const { return static_cast<double>(streamAudio_.size()) / SAMPLE_RATE; }
+    double streamWhisperSeconds() const { return whisperSeconds_; }
+
     void shutdown();
 
 private:
+    struct Segment {
+        std::string text;
+        int64_t endSample;  // relative to the start of the decoded window
+    };
+
+    // run whisper over a window, serialized on ctx_. A partial decode can be
+    // abandoned through abortPartial_ once the final one is wanted instead.
+    bool decode(const float* samples, size_t n, const std::string& prompt, std::vector<Segment>& out,
+                bool partial = false);
+    void streamLoop();
+    void printTranscript(const std::string& text) const;
+
     whisper_context*ctx_;
+    std::mutex whisperMutex_;
+    std::atomic<bool> abortPartial_{false};
+    double whisperSeconds_ = 0.0;   // under whisperMutex_, since beginStream()
+    bool quiet_ = false;
+
+    // streaming state
+    std::span<const float> streamAudio_;
+    size_t committedSamples_ = 0;  // audio before this offset is final
+    size_t decodedSamples_ = 0;    // end of the last decoded window
+    std::string committedText_;
+    bool streaming_ = false;
+    std::mutex streamMutex_;
+    std::condition_variable streamCv_;
+    std::thread streamThread_;
+
+    static constexpr size_t SAMPLE_RATE = 16000;
+    static constexpr size_t MIN_SAMPLES = SAMPLE_RATE / 10;       // whisper needs at least 0.1s
+    static constexpr size_t STREAM_STEP = SAMPLE_RATE;            // re-decode after 1s of new audio
+    static constexpr size_t STABLE_MARGIN = SAMPLE_RATE;          // segments ending 1s before the window end are stable
+    static constexpr size_t MAX_WINDOW = SAMPLE_RATE * 25;        // stay under whisper's 30s input window
+    static constexpr size_t PROMPT_CHARS = 200;                   // committed text passed as decoder context
+    static constexpr int AUDIO_CTX_FULL = 1500;                   // encoder frames in whisper's 30s window
+    static constexpr int AUDIO_CTX_MIN = 256;                     // shorter contexts make whisper hallucinate
 
 };
 
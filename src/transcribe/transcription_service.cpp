@@ -0,0 +1,250 @@
+#include "transcription_service.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "../util/trace.h"
+
+static double msSince(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool TranscriptionService::init(const std::string& model_path, const TranscriptionServiceConfig& config) {
+    config_ = config;
+    config_.n_states = std::max(1, config.n_states);
+    config_.threads_per_state = std::max(1, config.threads_per_state);
+    config_.max_batch = std::max(1, config.max_batch);
+
+    whisper_log_set([](enum ggml_log_level, const char*, void*) {}, nullptr);
+
+    whisper_context_params context_params = whisper_context_default_params();
+    context_params.use_gpu = config.use_gpu;
+
+    // weights only, every worker brings its own state
+    ctx_ = whisper_init_from_file_with_params_no_state(model_path.c_str(), context_params);
+    if (!ctx_) {
+        std::cerr << "Failed to load Whisper model " << model_path << "\n";
+        return false;
+    }
+
+    for (int i = 0; i < config_.n_states; i++) {
+        whisper_state* state = whisper_init_state(ctx_);
+        if (!state) {
+            std::cerr << "Failed to create Whisper state " << i << "\n";
+            shutdown();
+            return false;
+        }
+        Worker* worker = new Worker();
+        worker->state = state;
+        worker->jobs.reserve(config_.max_batch);
+        worker->starts.reserve(config_.max_batch);
+        worker->texts.resize(config_.max_batch);
+        workers_.push_back(worker);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+        started_ = Clock::now();
+        stats_ = TranscriptionStats();
+    }
+    for (Worker* worker : workers_) {
+        worker->thread = std::thread(&TranscriptionService::workerLoop, this, worker);
+    }
+
+    std::cerr << "Whisper: " << config_.n_states << " states x " << config_.threads_per_state << " threads\n";
+    return true;
+}
+
+bool TranscriptionService::submit(std::vector<float> audio, TranscriptionCallback on_done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || workers_.empty() || queue_.size() >= config_.queue_capacity) {
+            stats_.rejected++;
+            return false;
+        }
+        queue_.push_back({ std::move(audio), std::move(on_done), Clock::now() });
+        stats_.submitted++;
+    }
+    workCv_.notify_one();
+    return true;
+}
+
+TranscriptionResult TranscriptionService::transcribe(std::vector<float> audio) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    TranscriptionResult result;
+
+    bool submitted = submit(std::move(audio), [&](const TranscriptionResult& r) {
+        // notified under the lock, the frame goes away as soon as done is seen
+        std::lock_guard<std::mutex> lock(mutex);
+        result = r;
+        done = true;
+        cv.notify_one();
+    });
+    if (!submitted) return result;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return done; });
+    return result;
+}
+
+TranscriptionStats TranscriptionService::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TranscriptionStats stats = stats_;
+    stats.wall_ms = msSince(started_, Clock::now());
+    return stats;
+}
+
+void TranscriptionService::workerLoop(Worker* worker) {
+    TRACE_THREAD_NAME("stt state");
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workCv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) break;
+            takeJobs(*worker);
+        }
+        decode(*worker);
+    }
+}
+
+// Under mutex_: the oldest job, plus the short ones queued behind it while
+// they fit in one window.
+void TranscriptionService::takeJobs(Worker& worker) {
+    worker.jobs.clear();
+    worker.jobs.push_back(std::move(queue_.front()));
+    queue_.pop_front();
+
+    const size_t shortSamples = static_cast<size_t>(config_.short_seconds * SAMPLE_RATE);
+    const size_t windowSamples = static_cast<size_t>(config_.batch_seconds * SAMPLE_RATE);
+    const size_t first = worker.jobs[0].audio.size();
+    if (!config_.batch_short || first < MIN_SAMPLES || first > shortSamples) return;
+
+    size_t total = first;
+    for (auto it = queue_.begin(); it != queue_.end() && static_cast<int>(worker.jobs.size()) < config_.max_batch;) {
+        const size_t n = it->audio.size();
+        if (n < MIN_SAMPLES || n > shortSamples || total + GAP_SAMPLES + n > windowSamples) {
+            ++it;
+            continue;
+        }
+        total += GAP_SAMPLES + n;
+        worker.jobs.push_back(std::move(*it));
+        it = queue_.erase(it);
+    }
+}
+
+void TranscriptionService::decode(Worker& worker) {
+    const auto start = Clock::now();
+    const size_t n_jobs = worker.jobs.size();
+    for (size_t i = 0; i < n_jobs; i++) worker.texts[i].clear();
+
+    // one job decodes in place, several are laid out with silence between them
+    const float* samples = worker.jobs[0].audio.data();
+    size_t n_samples = worker.jobs[0].audio.size();
+    worker.starts.clear();
+    worker.starts.push_back(0);
+    if (n_jobs > 1) {
+        worker.packed.clear();
+        for (size_t i = 0; i < n_jobs; i++) {
+            if (i > 0) {
+                worker.packed.insert(worker.packed.end(), GAP_SAMPLES, 0.0f);
+                worker.starts.push_back(static_cast<int64_t>(worker.packed.size() / (SAMPLE_RATE / 100)));
+            }
+            worker.packed.insert(worker.packed.end(), worker.jobs[i].audio.begin(), worker.jobs[i].audio.end());
+        }
+        samples = worker.packed.data();
+        n_samples = worker.packed.size();
+    }
+
+    bool ok = n_samples >= MIN_SAMPLES;
+    if (ok) {
+        whisper_full_params full_params = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+        full_params.print_progress   = false;
+        full_params.print_timestamps = false;
+        full_params.print_realtime   = false;
+        full_params.single_segment   = false;
+        full_params.language         = "en";
+        full_params.n_threads        = config_.threads_per_state;
+        full_params.no_context       = true;
+        full_params.token_timestamps = n_jobs > 1;
+
+        ok = whisper_full_with_state(ctx_, worker.state, full_params, samples, static_cast<int>(n_samples)) == 0;
+    }
+
+    if (ok) {
+        const int numSegments = whisper_full_n_segments_from_state(worker.state);
+        if (n_jobs == 1) {
+            for (int i = 0; i < numSegments; i++) {
+                worker.texts[0] += whisper_full_get_segment_text_from_state(worker.state, i);
+            }
+        } else {
+            // a segment can run across the gap, so every token goes to the
+            // utterance its midpoint falls in
+            const whisper_token eot = whisper_token_eot(ctx_);
+            for (int i = 0; i < numSegments; i++) {
+                const int numTokens = whisper_full_n_tokens_from_state(worker.state, i);
+                for (int j = 0; j < numTokens; j++) {
+                    whisper_token_data token = whisper_full_get_token_data_from_state(worker.state, i, j);
+                    if (token.id >= eot) continue;
+
+                    const int64_t mid = (token.t0 + token.t1) / 2;
+                    size_t job = std::upper_bound(worker.starts.begin(), worker.starts.end(), mid) - worker.starts.begin();
+                    job = job > 0 ? job - 1 : 0;
+                    worker.texts[job] += whisper_full_get_token_text_from_state(ctx_, worker.state, i, j);
+                }
+            }
+        }
+    }
+
+    const auto end = Clock::now();
+    const double decodeMs = msSince(start, end);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.decodes++;
+        stats_.decode_ms += decodeMs;
+        if (n_jobs > 1) stats_.batched += n_jobs;
+        for (const Job& job : worker.jobs) {
+            const double queueMs = msSince(job.submitted, start);
+            stats_.completed++;
+            stats_.audio_s += static_cast<double>(job.audio.size()) / SAMPLE_RATE;
+            stats_.queue_ms += queueMs;
+            stats_.max_queue_ms = std::max(stats_.max_queue_ms, queueMs);
+        }
+    }
+
+    for (size_t i = 0; i < n_jobs; i++) {
+        Job& job = worker.jobs[i];
+        TranscriptionResult result;
+        result.text = std::move(worker.texts[i]);
+        result.ok = ok && job.audio.size() >= MIN_SAMPLES;
+        result.audio_s = static_cast<double>(job.audio.size()) / SAMPLE_RATE;
+        result.queue_ms = msSince(job.submitted, start);
+        result.decode_ms = decodeMs;
+        result.batch = static_cast<int>(n_jobs);
+        if (job.on_done) job.on_done(result);
+    }
+    worker.jobs.clear();
+}
+
+void TranscriptionService::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    workCv_.notify_all();
+
+    for (Worker* worker : workers_) {
+        if (worker->thread.joinable()) worker->thread.join();
+        if (worker->state) whisper_free_state(worker->state);
+        delete worker;
+    }
+    workers_.clear();
+
+    if (ctx_) {
+        whisper_free(ctx_);
+        ctx_ = nullptr;
+    }
+}
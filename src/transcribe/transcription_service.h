@@ -0,0 +1,125 @@
+#ifndef TRANSCRIPTION_SERVICE_H
+#define TRANSCRIPTION_SERVICE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <whisper.h>
+
+struct TranscriptionServiceConfig {
+    int n_states = 2;               // utterances decoded at once, one worker thread each
+    int threads_per_state = 4;      // whisper threads per decode; n_states * this ~ physical cores
+    bool use_gpu = true;
+    size_t queue_capacity = 64;     // submit() refuses beyond this
+
+    // Whisper pads every input to a 30 s window, so a 2 s utterance costs
+    // the encoder as much as a 25 s one. Short utterances waiting in the
+    // queue are packed into one window, separated by silence, and split
+    // back by token timestamps.
+    bool batch_short = true;
+    float short_seconds = 8.0f;     // longer utterances are always decoded alone
+    float batch_seconds = 25.0f;    // packed audio, gaps included, stays under whisper's window
+    int max_batch = 4;
+};
+
+struct TranscriptionResult {
+    std::string text;
+    bool ok = false;            // false if whisper failed or the audio was too short
+    double audio_s = 0.0;
+    double queue_ms = 0.0;      // submit() until a state picked it up
+    double decode_ms = 0.0;     // whisper time of the window it was in
+    int batch = 0;              // utterances sharing that window
+};
+
+// totals since init
+struct TranscriptionStats {
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t rejected = 0;      // queue full or shutting down
+    uint64_t decodes = 0;       // whisper_full calls
+    uint64_t batched = 0;       // utterances that shared a window with others
+    double audio_s = 0.0;
+    double decode_ms = 0.0;     // summed over states
+    double queue_ms = 0.0;
+    double max_queue_ms = 0.0;
+    double wall_ms = 0.0;
+
+    // seconds of audio per second of wall time, scales with n_states
+    double throughput() const { return wall_ms > 0.0 ? audio_s * 1000.0 / wall_ms : 0.0; }
+    double meanQueueMs() const { return completed > 0 ? queue_ms / completed : 0.0; }
+};
+
+// runs on a worker thread
+using TranscriptionCallback = std::function<void(const TranscriptionResult& result)>;
+
+// Many utterances at once on one copy of the weights. The whisper_context
+// is loaded without a state and each worker owns a whisper_state (its KV
+// cache, mel buffer and decoder scratch), so n_states workers decode in
+// parallel with whisper_full_with_state where Transcribe serializes on
+// its single context.
+class TranscriptionService {
+public:
+    TranscriptionService() = default;
+    ~TranscriptionService() { shutdown(); }
+
+    TranscriptionService(const TranscriptionService&) = delete;
+    TranscriptionService& operator=(const TranscriptionService&) = delete;
+
+    bool init(const std::string& model_path, const TranscriptionServiceConfig& config = TranscriptionServiceConfig());
+
+    // 16 kHz mono; false when the queue is full or the service is stopping
+    bool submit(std::vector<float> audio, TranscriptionCallback on_done);
+
+    // submit() and wait, from any thread but the workers
+    TranscriptionResult transcribe(std::vector<float> audio);
+
+    TranscriptionStats stats() const;
+
+    // finishes what is queued, then frees the states and the model
+    void shutdown();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::vector<float> audio;
+        TranscriptionCallback on_done;
+        Clock::time_point submitted;
+    };
+
+    struct Worker {
+        whisper_state* state = nullptr;
+        std::thread thread;
+        std::vector<Job> jobs;              // the window being decoded
+        std::vector<float> packed;
+        std::vector<int64_t> starts;        // each job's offset in packed, in 10 ms units
+        std::vector<std::string> texts;
+    };
+
+    void workerLoop(Worker* worker);
+    void takeJobs(Worker& worker);
+    void decode(Worker& worker);
+
+    TranscriptionServiceConfig config_;
+    whisper_context* ctx_ = nullptr;
+    std::vector<Worker*> workers_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable workCv_;
+    std::deque<Job> queue_;
+    bool stopping_ = false;
+    Clock::time_point started_;
+    TranscriptionStats stats_;
+
+    static constexpr size_t SAMPLE_RATE = 16000;
+    static constexpr size_t MIN_SAMPLES = SAMPLE_RATE / 10;   // whisper needs at least 0.1s
+    static constexpr size_t GAP_SAMPLES = SAMPLE_RATE;        // silence between packed utterances
+};
+
+#endif
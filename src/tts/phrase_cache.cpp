@@ -0,0 +1,183 @@
+#include "phrase_cache.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static constexpr uint32_t PHRASE_PACK_MAGIC = 0x3143504a; // "JPC1"
+
+// a phrase is a sentence or two, anything bigger means a corrupt pack
+static constexpr uint32_t MAX_KEY_BYTES = 4096;
+static constexpr uint32_t MAX_PHRASE_SECONDS = 60;
+
+struct PhrasePackHeader {
+    uint32_t magic;
+    int32_t sample_rate;
+    uint64_t count;
+};
+
+std::string PhraseCache::normalize(const std::string& text) {
+    std::string out;
+    out.reserve(text.size());
+    bool space = false;
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            space = !out.empty();
+            continue;
+        }
+        if (space) {
+            out += ' ';
+            space = false;
+        }
+        out += static_cast<char>(c < 0x80 ? std::tolower(c) : c);
+    }
+    return out;
+}
+
+std::string PhraseCache::makeKey(const std::string& text, const std::string& voice, int32_t sid, float speed) {
+    // speed in hundredths so 1.0f and 1.0000001f share an entry
+    long centi = std::lround(speed * 100.0f);
+    return normalize(text) + '\x1f' + voice + '\x1f' + std::to_string(sid) + '\x1f' + std::to_string(centi);
+}
+
+void PhraseCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evictLocked();
+}
+
+PhraseCache::Pcm PhraseCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->samples;
+}
+
+void PhraseCache::insert(const std::string& key, std::vector<int16_t> samples) {
+    if (samples.empty()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (budget_ == 0) return;
+
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        bytes_ -= entryBytes(*it->second);
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+
+    lru_.push_front({ key, std::make_shared<const std::vector<int16_t>>(std::move(samples)) });
+    index_[key] = lru_.begin();
+    bytes_ += entryBytes(lru_.front());
+    evictLocked();
+}
+
+void PhraseCache::evictLocked() {
+    while (bytes_ > budget_ && !lru_.empty()) {
+        bytes_ -= entryBytes(lru_.back());
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+        evictions_++;
+    }
+}
+
+PhraseCacheStats PhraseCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PhraseCacheStats s;
+    s.hits = hits_;
+    s.misses = misses_;
+    s.evictions = evictions_;
+    s.entries = lru_.size();
+    s.bytes = bytes_;
+    return s;
+}
+
+bool PhraseCache::load(const std::string& path, int32_t sample_rate) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+
+    PhrasePackHeader h{};
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+        h.magic != PHRASE_PACK_MAGIC || h.sample_rate != sample_rate) {
+        std::cerr << "Ignoring phrase cache " << path << " (wrong format or sample rate)\n";
+        return false;
+    }
+
+    std::string key;
+    std::vector<int16_t> samples;
+    for (uint64_t i = 0; i < h.count; i++) {
+        uint32_t keyLen = 0, n = 0;
+        if (!in.read(reinterpret_cast<char*>(&keyLen), sizeof(keyLen)) ||
+            !in.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+            break;
+        }
+
+        // checked before anything is allocated for them
+        const uint64_t remaining = fileSize - static_cast<uint64_t>(in.tellg());
+        const uint64_t maxSamples = static_cast<uint64_t>(MAX_PHRASE_SECONDS) * static_cast<uint64_t>(sample_rate);
+        if (keyLen > MAX_KEY_BYTES || n > maxSamples || keyLen + static_cast<uint64_t>(n) * sizeof(int16_t) > remaining) {
+            std::cerr << "Phrase cache " << path << " is corrupt or truncated\n";
+            break;
+        }
+        key.resize(keyLen);
+        samples.resize(n);
+        if (!in.read(key.data(), keyLen) ||
+            !in.read(reinterpret_cast<char*>(samples.data()), static_cast<std::streamsize>(n) * sizeof(int16_t))) {
+            std::cerr << "Phrase cache " << path << " is truncated\n";
+            break;
+        }
+        // stored oldest first, so inserting in order rebuilds the recency
+        insert(key, samples);
+    }
+    return true;
+}
+
+bool PhraseCache::save(const std::string& path, int32_t sample_rate) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::error_code ec;
+    std::filesystem::path p(path);
+    if (p.has_parent_path()) std::filesystem::create_directories(p.parent_path(), ec);
+
+    std::string tmp = path + ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to write " << tmp << "\n";
+        return false;
+    }
+
+    PhrasePackHeader h{ PHRASE_PACK_MAGIC, sample_rate, lru_.size() };
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it) {
+        uint32_t keyLen = static_cast<uint32_t>(it->key.size());
+        uint32_t n = static_cast<uint32_t>(it->samples->size());
+        out.write(reinterpret_cast<const char*>(&keyLen), sizeof(keyLen));
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        out.write(it->key.data(), keyLen);
+        out.write(reinterpret_cast<const char*>(it->samples->data()), static_cast<std::streamsize>(n) * sizeof(int16_t));
+    }
+
+    out.close();
+    if (!out) {
+        std::cerr << "Failed to write " << tmp << "\n";
+        return false;
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "Failed to move " << tmp << " to " << path << "\n";
+        return false;
+    }
+    return true;
+}
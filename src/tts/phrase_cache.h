@@ -0,0 +1,70 @@
+#ifndef PHRASE_CACHE_H
+#define PHRASE_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PhraseCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+
+    double hitRate() const {
+        uint64_t total = hits + misses;
+        return total ? static_cast<double>(hits) / total : 0.0;
+    }
+};
+
+// LRU of synthesized PCM for short phrases that come up again and again
+// ("Well,", "Hmm, let me see..."). Thread safe, shared by all TTS workers.
+class PhraseCache {
+public:
+    using Pcm = std::shared_ptr<const std::vector<int16_t>>;
+
+    // lowercase, collapse whitespace; punctuation stays since it changes prosody
+    static std::string normalize(const std::string& text);
+
+    // normalized text plus everything else that changes the audio
+    static std::string makeKey(const std::string& text, const std::string& voice, int32_t sid, float speed);
+
+    void setBudget(size_t bytes);
+
+    // counts a hit or a miss, marks the entry most recently used
+    Pcm find(const std::string& key);
+    void insert(const std::string& key, std::vector<int16_t> samples);
+
+    PhraseCacheStats stats() const;
+
+    // Compact pack: header, then key length, sample count, key bytes and
+    // int16 samples per entry, least recently used first. A pack written for
+    // another sample rate is ignored.
+    bool load(const std::string& path, int32_t sample_rate);
+    bool save(const std::string& path, int32_t sample_rate) const;
+
+private:
+    struct Entry {
+        std::string key;
+        Pcm samples;
+    };
+
+    static size_t entryBytes(const Entry& e) { return e.key.size() + e.samples->size() * sizeof(int16_t); }
+    void evictLocked();
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;   // most recently used at the front
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t budget_ = 0;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "tts.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <cstring>
 #include <atomic>
@@ -6,12 +8,13 @@
 #include <chrono>
 
 #include "sherpa-onnx/c-api/c-api.h"
+#include "../util/trace.h"
 
 bool TextToSpeech::init(const TTSConfig& cfg) {
     SherpaOnnxOfflineTtsConfig config;
     memset(&config, 0, sizeof(config));
 
-    config.model.num_threads = 6;
+    config.model.num_threads = std::max(1, cfg.threads_per_worker);
     config.model.provider = "cpu";
 
     if (cfg.engine == TTSEngine::Piper) {
@@ -27,16 +30,69 @@ bool TextToSpeech::init(const TTSConfig& cfg) {
         config.model.kokoro.data_dir = cfg.data_dir.c_str();
     }
 
-    tts_ = SherpaOnnxCreateOfflineTts(&config);
-    if (!tts_) {
-        std::cerr << "Failed to create TTS engine\n";
-        return false;
+    const int workers = std::max(1, cfg.num_workers);
+    for (int i = 0; i < workers; i++) {
+        const SherpaOnnxOfflineTts* engine = SherpaOnnxCreateOfflineTts(&config);
+        if (!engine) {
+            std::cerr << "Failed to create TTS engine\n";
+            return false;
+        }
+        engines_.push_back(engine);
     }
 
+    tts_ = engines_[0];
     sample_rate_ = SherpaOnnxOfflineTtsSampleRate(tts_);
+    sid_ = cfg.speaker_id;
+    voice_ = std::string(cfg.engine == TTSEngine::Kokoro ? "kokoro:" : "piper:") + cfg.model_path;
+
+    cache_.setBudget(cfg.cache_bytes);
+    cacheMaxChars_ = cfg.cache_bytes > 0 ? cfg.cache_max_chars : 0;
+    cachePath_ = cfg.cache_path;
+    if (!cachePath_.empty() && cache_.load(cachePath_, sample_rate_)) {
+        std::cerr << "Loaded " << cache_.stats().entries << " cached phrases\n";
+    }
+
+    if (!cfg.open_device) {
+        // offline: the writer collects each reply in offline_ instead
+        return true;
+    }
+
+    // allocated before the output runs, the callback reads it from then on
+    ring_.init(static_cast<size_t>(sample_rate_) * RING_SECONDS);
+
+    // the output stays open for the whole session and plays silence
+    // between turns, so a reply never waits for device setup
+    AudioIOConfig output = cfg.output;
+    output.sample_rate = static_cast<uint32_t>(sample_rate_);
+    sink_ = createAudioSink(output);
+    if (!sink_) {
+        return false;
+    }
+    if (!sink_->start(audioCallback, this)) {
+        delete sink_;
+        sink_ = nullptr;
+        return false;
+    }
+    if (output.backend != AudioBackend::Device) {
+        std::cerr << "Playing to " << sink_->name() << (output.path.empty() ? "" : " " + output.path) << "\n";
+    }
     return true;
 }
 
+void TextToSpeech::warmup() {
+    // every engine builds its onnxruntime session lazily on the first run
+    std::vector<std::thread> threads;
+    for (const SherpaOnnxOfflineTts* engine : engines_) {
+        threads.emplace_back([this, engine] {
+            const SherpaOnnxGeneratedAudio* audio = SherpaOnnxOfflineTtsGenerate(engine, "Hi.", sid_, 1.0f);
+            if (audio) SherpaOnnxDestroyOfflineTtsGeneratedAudio(audio);
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+}
+
 
 // helper function to clean response of emojis and non-valid characters
 static std::string sanitizeForTTS(const std::string& text) {
@@ -81,7 +137,7 @@ void TextToSpeech::speak(const std::string& text, float speed) {
     if (text.empty()) { return; }
 
     // generate audio
-    const SherpaOnnxGeneratedAudio* audio = SherpaOnnxOfflineTtsGenerate(tts_, text.c_str(), /*sid=*/11, speed);
+    const SherpaOnnxGeneratedAudio* audio = SherpaOnnxOfflineTtsGenerate(tts_, text.c_str(), sid_, speed);
 
     if (!audio || audio->n == 0) {
         std::cerr << "Failed to generate audio\n";
@@ -92,261 +148,427 @@ void TextToSpeech::speak(const std::string& text, float speed) {
     }
 
     // play the audio
-    playAudio(audio->samples, audio->n, audio->sample_rate);
+    playAudio(audio->samples, audio->n);
 
     // cleanup
     SherpaOnnxDestroyOfflineTtsGeneratedAudio(audio);
 }
 
-// playback state passed to callback
-struct PlaybackData {
-    const int16_t* samples;
-    int32_t totalFrames;
-    std::atomic<int32_t> currentFrame;
-};
-
-// miniaudio callback for playback
-static void playbackCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
-    (void)pInput;
-    PlaybackData* data = static_cast<PlaybackData*>(pDevice->pUserData);
-    int16_t* output = static_cast<int16_t*>(pOutput);
+// float [-1,1] from sherpa-onnx to the output's int16
+static void appendPcm16(std::vector<int16_t>& out, const float* samples, int32_t n) {
+    size_t base = out.size();
+    out.resize(base + n);
+    for (int32_t i = 0; i < n; i++) {
+        float s = samples[i];
+        if (s > 1.0f) s = 1.0f;
+        if (s < -1.0f) s = -1.0f;
+        out[base + i] = static_cast<int16_t>(s * 32767.0f);
+    }
+}
 
-    int32_t current = data->currentFrame.load();
-    int32_t framesRemaining = data->totalFrames - current;
-    ma_uint32 framesToCopy = (static_cast<int32_t>(frameCount) < framesRemaining)
-                              ? frameCount
-                              : static_cast<ma_uint32>(framesRemaining);
+void TextToSpeech::playAudio(const float* samples, int32_t n) {
+    std::vector<int16_t> pcm;
+    appendPcm16(pcm, samples, n);
 
-    if (framesToCopy > 0) {
-        memcpy(output, data->samples + current, framesToCopy * sizeof(int16_t));
-        data->currentFrame.fetch_add(static_cast<int32_t>(framesToCopy));
+    if (!sink_) {
+        offline_ = std::move(pcm);
+        return;
     }
 
-    // Fill remaining with silence
-    if (framesToCopy < frameCount) {
-        memset(output + framesToCopy, 0, (frameCount - framesToCopy) * sizeof(int16_t));
+    // through the same ring as streamed replies, a stale barge-in must not mute it
+    if (!streaming_) cancel_.reset();
+    pushAudio(pcm.data(), pcm.size());
+    waitForPlayback();
+}
+
+struct SynthesisProgress {
+    TextToSpeech* tts;
+    uint64_t seq;
+    int32_t delivered;   // samples handed over through the callback so far
+    bool stopped;        // cancelled part way, the phrase is incomplete
+};
+
+int32_t TextToSpeech::progressCallback(const float* samples, int32_t n, float progress, void* arg) {
+    (void)progress;
+    SynthesisProgress* p = static_cast<SynthesisProgress*>(arg);
+    if (n > 0) {
+        p->tts->appendAudio(p->seq, samples, n);
+        p->delivered += n;
+    }
+    if (p->tts->cancelled()) {
+        p->stopped = true;
+        return 0;   // stop before the next sentence batch
     }
+    return 1;   // keep going
 }
 
-void TextToSpeech::playAudio(const float* samples, int32_t n, int32_t sample_rate) {
-    // convert float [-1,1] to int16 for playback
-    std::vector<int16_t> pcm(n);
-    for (int32_t i = 0; i < n; i++) {
-        float sample = samples[i];
-        if (sample > 1.0f) sample = 1.0f;
-        if (sample < -1.0f) sample = -1.0f;
-        pcm[i] = static_cast<int16_t>(sample * 32767.0f);
-    }
-
-    // playback state
-    PlaybackData playbackData;
-    playbackData.samples = pcm.data();
-    playbackData.totalFrames = n;
-    playbackData.currentFrame.store(0);
-
-    // set up playback device with callback
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-    deviceConfig.playback.format   = ma_format_s16;
-    deviceConfig.playback.channels = 1;
-    deviceConfig.sampleRate        = static_cast<ma_uint32>(sample_rate);
-    deviceConfig.pUserData         = &playbackData;
-    deviceConfig.dataCallback      = playbackCallback;
-
-    ma_device device;
-    if (ma_device_init(nullptr, &deviceConfig, &device) != MA_SUCCESS) {
-        std::cerr << "Failed to initialize playback device\n";
-        return;
+void TextToSpeech::appendAudio(uint64_t seq, const float* samples, int32_t n) {
+    {
+        std::lock_guard<std::mutex> lock(audioMutex_);
+        appendPcm16(phrases_[seq].samples, samples, n);
     }
+    audioCv_.notify_all();
+}
 
-    if (ma_device_start(&device) != MA_SUCCESS) {
-        std::cerr << "Failed to start playback device\n";
-        ma_device_uninit(&device);
-        return;
+void TextToSpeech::synthesize(const SherpaOnnxOfflineTts* engine, uint64_t seq, const std::string& text, float speed,
+                              const std::string& cache_key) {
+    TRACE_SCOPE_TOTAL("tts synth", TurnCount::SynthSeconds);
+    SynthesisProgress progress{ this, seq, 0, false };
+    auto start = std::chrono::steady_clock::now();
+
+    const SherpaOnnxGeneratedAudio* audio = nullptr;
+    if (engine && !text.empty()) {
+        audio = SherpaOnnxOfflineTtsGenerateWithProgressCallbackWithArg(
+            engine, text.c_str(), sid_, speed, progressCallback, &progress);
     }
 
-    // wait until playback is done
-    while (playbackData.currentFrame.load() < playbackData.totalFrames) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::vector<int16_t> toCache;
+    {
+        std::lock_guard<std::mutex> lock(audioMutex_);
+        PhraseAudio& phrase = phrases_[seq];
+        // the callback normally delivers everything, keep whatever it did not
+        if (audio && audio->n > progress.delivered) {
+            appendPcm16(phrase.samples, audio->samples + progress.delivered, audio->n - progress.delivered);
+        }
+        phrase.finished = true;
+        if (!cache_key.empty() && !progress.stopped) toCache = phrase.samples;
+
+        // smoothed over phrases, the chunker sizes the next ones with it
+        if (!progress.stopped && !phrase.samples.empty()) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            float rtf = static_cast<float>(seconds * sample_rate_ / phrase.samples.size());
+            float smoothed = rtf_.load(std::memory_order_relaxed);
+            rtf_.store(smoothed > 0.0f ? smoothed + 0.3f * (rtf - smoothed) : rtf, std::memory_order_relaxed);
+        }
+        TRACE_COUNT(TurnCount::SpeechSeconds, static_cast<double>(phrase.samples.size()) / sample_rate_);
     }
+    audioCv_.notify_all();
+
+    if (audio) SherpaOnnxDestroyOfflineTtsGeneratedAudio(audio);
 
-    // small delay to let final buffer drain
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (!toCache.empty()) {
+        cache_.insert(cache_key, std::move(toCache));
+    }
+}
 
-    ma_device_stop(&device);
-    ma_device_uninit(&device);
+uint32_t TextToSpeech::audioCallback(void* user, int16_t* output, uint32_t frameCount) {
+    return static_cast<TextToSpeech*>(user)->fillAudioBuffer(output, frameCount);
 }
 
-AudioBuffer TextToSpeech::generateAudio(const std::string& text, float speed) {
-    AudioBuffer buf;
-    buf.sample_rate = sample_rate_;
+// real-time thread: no locks, no allocation, just copy out of the ring
+uint32_t TextToSpeech::fillAudioBuffer(int16_t* output, uint32_t frameCount) {
+    // interrupted: whatever is still queued goes, silence from this period on
+    if (cancel_.cancelled()) {
+        if (ring_.discard() > 0) {
+            played_.fetch_add(1, std::memory_order_release);
+            played_.notify_all();
+        }
+        memset(output, 0, frameCount * sizeof(int16_t));
+        silentPeriods_.fetch_add(1, std::memory_order_release);
+        silentPeriods_.notify_all();
+        return 0;
+    }
 
-    if (!tts_ || text.empty()) return buf;
+    size_t got = ring_.read(output, frameCount);
 
-    const SherpaOnnxGeneratedAudio* audio = SherpaOnnxOfflineTtsGenerate(tts_, text.c_str(), 11, speed);
-    if (!audio || audio->n == 0) {
-        if (audio) SherpaOnnxDestroyOfflineTtsGeneratedAudio(audio);
-        return buf;
-    }
+    if (got > 0) {
+        playedSamples_.fetch_add(got, std::memory_order_relaxed);
 
-    buf.sample_rate = audio->sample_rate;
-    buf.samples.resize(audio->n);
-    for (int32_t i = 0; i < audio->n; i++) {
-        float s = audio->samples[i];
-        if (s > 1.0f) s = 1.0f;
-        if (s < -1.0f) s = -1.0f;
-        buf.samples[i] = static_cast<int16_t>(s * 32767.0f);
+        float sum = 0.0f;
+        for (size_t i = 0; i < got; i++) {
+            float s = output[i] * (1.0f / 32768.0f);
+            sum += s * s;
+        }
+        float level = std::sqrt(sum / static_cast<float>(got));
+        if (level > outputLevel_.load(std::memory_order_relaxed)) {
+            outputLevel_.store(level, std::memory_order_relaxed);
+        }
+
+        if (firstAudioTicks_.load(std::memory_order_relaxed) == 0) {
+            firstAudioTicks_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        }
+        // wakes a producer waiting for space or for the drain, no lock involved
+        played_.fetch_add(1, std::memory_order_release);
+        played_.notify_all();
     }
+    if (got == frameCount) return frameCount;
 
-    SherpaOnnxDestroyOfflineTtsGeneratedAudio(audio);
-    return buf;
-}
+    memset(output + got, 0, (frameCount - got) * sizeof(int16_t));
 
-void TextToSpeech::audioCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
-    (void)pInput;
-    TextToSpeech* tts = static_cast<TextToSpeech*>(pDevice->pUserData);
-    tts->fillAudioBuffer(static_cast<int16_t*>(pOutput), frameCount);
-}
+    // asked for another period with nothing left: the last samples are out
+    if (got == 0) {
+        silentPeriods_.fetch_add(1, std::memory_order_release);
+        silentPeriods_.notify_all();
+    }
 
-void TextToSpeech::fillAudioBuffer(int16_t* output, ma_uint32 frameCount) {
-    ma_uint32 framesWritten = 0;
+    // running dry before the generator is finished is an audible gap
+    if (audioStarted_.load(std::memory_order_relaxed) && !allDone_.load(std::memory_order_relaxed)) {
+        underruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return static_cast<uint32_t>(got);
+}
 
-    while (framesWritten < frameCount) {
-        // Try to read from current buffer
-        {
-            std::lock_guard<std::mutex> lock(playbackMutex_);
-            size_t pos = playbackPos_.load();
-            size_t available = currentBuffer_.size() - pos;
-
-            if (available > 0) {
-                size_t toCopy = std::min(static_cast<size_t>(frameCount - framesWritten), available);
-                memcpy(output + framesWritten, currentBuffer_.data() + pos, toCopy * sizeof(int16_t));
-                playbackPos_.fetch_add(toCopy);
-                framesWritten += static_cast<ma_uint32>(toCopy);
-                continue;
-            }
+// blocks while the ring is full, the callback frees space as it plays
+void TextToSpeech::pushAudio(const int16_t* samples, size_t n) {
+    if (!sink_) {
+        pushedSamples_ += n;
+        // offline output counts as played the moment the writer hands it over
+        if (n > 0 && firstAudioTicks_.load(std::memory_order_relaxed) == 0) {
+            firstAudioTicks_.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
         }
+        offline_.insert(offline_.end(), samples, samples + n);
+        return;
+    }
 
-        // Current buffer exhausted, try to get next from queue
-        {
-            std::lock_guard<std::mutex> lock(audioMutex_);
-            if (!audioQueue_.empty()) {
-                std::lock_guard<std::mutex> plock(playbackMutex_);
-                currentBuffer_ = std::move(audioQueue_.front().samples);
-                audioQueue_.pop();
-                playbackPos_.store(0);
-                continue;
-            }
+    while (n > 0 && !cancel_.cancelled()) {
+        size_t written = ring_.write(samples, n);
+        samples += written;
+        n -= written;
+        pushedSamples_ += written;
+        if (written > 0) {
+            audioStarted_.store(true, std::memory_order_relaxed);
+        }
+        if (n > 0) {
+            uint32_t seen = played_.load(std::memory_order_acquire);
+            if (ring_.space() == 0) played_.wait(seen, std::memory_order_acquire);
         }
-
-        // No audio available, fill remaining with silence
-        memset(output + framesWritten, 0, (frameCount - framesWritten) * sizeof(int16_t));
-        break;
     }
 }
 
 void TextToSpeech::startStreaming() {
+    // reset what the callback reads before allDone_ arms underrun counting
+    audioStarted_ = false;
+    underruns_ = 0;
+    firstAudioTicks_ = 0;
     textDone_ = false;
     allDone_ = false;
     streaming_ = true;
-    currentBuffer_.clear();
-    playbackPos_.store(0);
-
-    // Initialize audio device once
-    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
-    deviceConfig.playback.format   = ma_format_s16;
-    deviceConfig.playback.channels = 1;
-    deviceConfig.sampleRate        = static_cast<ma_uint32>(sample_rate_);
-    deviceConfig.pUserData         = this;
-    deviceConfig.dataCallback      = audioCallback;
-
-    if (ma_device_init(nullptr, &deviceConfig, &device_) == MA_SUCCESS) {
-        deviceInitialized_ = true;
-        ma_device_start(&device_);
+    streamStart_ = std::chrono::steady_clock::now();
+    nextSeq_ = 0;
+    workersDone_ = false;
+    phrases_.clear();
+    offline_.clear();
+    cancel_.reset();
+    playedSamples_ = 0;
+    pushedSamples_ = 0;
+    phraseEnds_.clear();
+
+    // Start synthesis workers and the in-order writer
+    for (size_t i = 0; i < engines_.size(); i++) {
+        workers_.emplace_back(&TextToSpeech::workerLoop, this, i);
     }
-
-    // Start generator thread
-    generatorThread_ = std::thread(&TextToSpeech::generatorLoop, this);
+    writerThread_ = std::thread(&TextToSpeech::writerLoop, this);
 }
 
 void TextToSpeech::queueText(const std::string& text) {
+    if (cancel_.cancelled()) return;
+    TRACE_INSTANT("queue phrase");
+    TRACE_MARK(TurnMark::FirstPhrase);
     {
         std::lock_guard<std::mutex> lock(textMutex_);
-        textQueue_.push(text);
+        textQueue_.push({ nextSeq_++, text });
     }
     textCv_.notify_one();
 }
 
 void TextToSpeech::finishStreaming() {
-    // Signal generator that no more text is coming
+    // Signal workers that no more text is coming
     {
         std::lock_guard<std::mutex> lock(textMutex_);
         textDone_ = true;
     }
-    textCv_.notify_one();
+    textCv_.notify_all();
 
-    // Wait for generator to finish
-    if (generatorThread_.joinable()) {
-        generatorThread_.join();
+    for (std::thread& worker : workers_) {
+        worker.join();
     }
+    workers_.clear();
 
-    // Wait for all audio to be played
-    while (true) {
-        {
-            std::lock_guard<std::mutex> alock(audioMutex_);
-            std::lock_guard<std::mutex> plock(playbackMutex_);
-            if (audioQueue_.empty() && playbackPos_.load() >= currentBuffer_.size()) {
-                break;
-            }
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // Let the writer play out what is left
+    {
+        std::lock_guard<std::mutex> lock(audioMutex_);
+        workersDone_ = true;
     }
+    audioCv_.notify_all();
 
-    // Small delay for final buffer to drain
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (writerThread_.joinable()) {
+        writerThread_.join();
+    }
 
-    // Stop and cleanup device
-    if (deviceInitialized_) {
-        ma_device_stop(&device_);
-        ma_device_uninit(&device_);
-        deviceInitialized_ = false;
+    allDone_ = true;
+
+    waitForPlayback();
+
+    // the callback only stores a timestamp, it must not touch the tracer's lock
+    if (firstAudioTicks_.load(std::memory_order_relaxed) != 0) {
+        TRACE_MARK_AT(TurnMark::FirstAudio, firstAudioTime());
     }
+    TRACE_MARK(TurnMark::PlaybackEnd);
 
     streaming_ = false;
 }
 
-void TextToSpeech::generatorLoop() {
+void TextToSpeech::workerLoop(size_t worker) {
+    TRACE_THREAD_NAME("tts worker");
     while (true) {
-        std::string text;
+        PhraseJob job;
         {
             std::unique_lock<std::mutex> lock(textMutex_);
             textCv_.wait(lock, [this] {
-                return !textQueue_.empty() || textDone_;
+                return !textQueue_.empty() || textDone_ || cancel_.cancelled();
             });
 
-            if (textQueue_.empty() && textDone_) {
+            if (textQueue_.empty() || cancel_.cancelled()) {
                 break;
             }
 
-            if (!textQueue_.empty()) {
-                text = textQueue_.front();
-                textQueue_.pop();
+            job = std::move(textQueue_.front());
+            textQueue_.pop();
+        }
+
+        const float speed = 1.0f;
+        std::string key;
+        if (job.text.size() <= cacheMaxChars_) {
+            key = PhraseCache::makeKey(job.text, voice_, sid_, speed);
+            if (PhraseCache::Pcm cached = cache_.find(key)) {
+                // a hit is ready to play as soon as it is the writer's turn
+                {
+                    std::lock_guard<std::mutex> lock(audioMutex_);
+                    PhraseAudio& phrase = phrases_[job.seq];
+                    phrase.samples.assign(cached->begin(), cached->end());
+                    phrase.finished = true;
+                }
+                TRACE_INSTANT("tts cache hit");
+                TRACE_COUNT(TurnCount::SpeechSeconds, static_cast<double>(cached->size()) / sample_rate_);
+                audioCv_.notify_all();
+                continue;
             }
         }
 
-        if (!text.empty()) {
-            AudioBuffer buf = generateAudio(text, 1.0f);
+        synthesize(engines_[worker], job.seq, job.text, speed, key);
+    }
+}
+
+// Moves phrases into the playback ring strictly in queue order, waiting for
+// the next one even when later phrases are already done.
+void TextToSpeech::writerLoop() {
+    TRACE_THREAD_NAME("tts writer");
+    uint64_t nextPlay = 0;
+    size_t consumed = 0;
+
+    while (true) {
+        bool phraseDone = false;
+        {
+            std::unique_lock<std::mutex> lock(audioMutex_);
+            audioCv_.wait(lock, [&] {
+                if (cancel_.cancelled()) return true;
+                auto it = phrases_.find(nextPlay);
+                if (it == phrases_.end()) return workersDone_;
+                return it->second.samples.size() > consumed || it->second.finished;
+            });
+
+            auto it = phrases_.find(nextPlay);
+            if (it == phrases_.end() || cancel_.cancelled()) {
+                break;
+            }
+
+            const std::vector<int16_t>& samples = it->second.samples;
+            writeScratch_.assign(samples.begin() + consumed, samples.end());
+            consumed = samples.size();
 
-            if (!buf.samples.empty()) {
-                std::lock_guard<std::mutex> lock(audioMutex_);
-                audioQueue_.push(std::move(buf));
+            if (it->second.finished) {
+                phrases_.erase(it);
+                phraseDone = true;
             }
         }
+
+        // outside the lock, this blocks while the ring is full
+        pushAudio(writeScratch_.data(), writeScratch_.size());
+
+        if (phraseDone) {
+            if (!cancel_.cancelled()) phraseEnds_.push_back(pushedSamples_);
+            nextPlay++;
+            consumed = 0;
+        }
+    }
+}
+
+void TextToSpeech::cancel() {
+    cancel_.cancel();
+    {
+        std::lock_guard<std::mutex> lock(textMutex_);
+        textQueue_ = std::queue<PhraseJob>();
+    }
+    textCv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(audioMutex_);
     }
+    audioCv_.notify_all();
+
+    // a writer waiting for ring space wakes up and sees the cancel
+    played_.fetch_add(1, std::memory_order_release);
+    played_.notify_all();
+}
+
+double TextToSpeech::spokenPhrases() {
+    const uint64_t played = sink_ ? playedSamples_.load(std::memory_order_relaxed) : pushedSamples_;
+
+    size_t whole = 0;
+    while (whole < phraseEnds_.size() && phraseEnds_[whole] <= played) whole++;
+
+    const uint64_t start = whole > 0 ? phraseEnds_[whole - 1] : 0;
+    uint64_t length;
+    if (whole < phraseEnds_.size()) {
+        length = phraseEnds_[whole] - start;
+    } else {
+        // cut off part way, measured against what had been synthesized of it
+        std::lock_guard<std::mutex> lock(audioMutex_);
+        auto it = phrases_.find(whole);
+        length = it != phrases_.end() ? it->second.samples.size() : pushedSamples_ - start;
+    }
+
+    if (played <= start || length == 0) return static_cast<double>(whole);
+    return whole + std::min(1.0, static_cast<double>(played - start) / static_cast<double>(length));
+}
+
+// woken by the callback on every period it plays. An empty ring only means
+// the last period was handed to the device, it is heard once the callback
+// comes back for another and finds nothing.
+void TextToSpeech::waitForPlayback() {
+    if (!sink_) return;
+    while (true) {
+        uint32_t seen = played_.load(std::memory_order_acquire);
+        if (ring_.size() == 0) break;
+        played_.wait(seen, std::memory_order_acquire);
+    }
+    uint32_t silent = silentPeriods_.load(std::memory_order_acquire);
+    silentPeriods_.wait(silent, std::memory_order_acquire);
+}
+
+std::chrono::steady_clock::time_point TextToSpeech::firstAudioTime() const {
+    int64_t ticks = firstAudioTicks_.load(std::memory_order_relaxed);
+    return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+}
+
+double TextToSpeech::timeToFirstAudioMs() const {
+    if (firstAudioTicks_.load(std::memory_order_relaxed) == 0) return -1.0;
+    return std::chrono::duration<double, std::milli>(firstAudioTime() - streamStart_).count();
 }
 
 void TextToSpeech::shutdown() {
-    if (tts_) {
-        SherpaOnnxDestroyOfflineTts(tts_);
-        tts_ = nullptr;
+    if (sink_) {
+        sink_->stop();
+        delete sink_;
+        sink_ = nullptr;
+    }
+
+    if (!engines_.empty() && !cachePath_.empty()) {
+        cache_.save(cachePath_, sample_rate_);
+    }
+
+    for (const SherpaOnnxOfflineTts* engine : engines_) {
+        SherpaOnnxDestroyOfflineTts(engine);
     }
+    engines_.clear();
+    tts_ = nullptr;
 }
@@ -2,16 +2,21 @@
 #define TTS_H
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <map>
 #include <queue>
 #include <thread>
 #include <mutex>
 
 #include "sherpa-onnx/c-api/c-api.h"
-#include "miniaudio.h"
+#include "../audio/audio_io.h"
+#include "../audio/spsc_ring.h"
+#include "../util/cancel_token.h"
+#include "phrase_cache.h"
 
 enum class TTSEngine {
     Piper,
@@ -24,21 +29,31 @@ struct TTSConfig {
     std::string tokens_path;
     std::string data_dir;
     std::string voices_path;  // Kokoro only
-};
 
-// Pre-generated audio buffer
-struct AudioBuffer {
-    std::vector<int16_t> samples;
-    int32_t sample_rate;
+    int num_workers = 1;          // phrases synthesized in parallel, one engine instance each
+    int threads_per_worker = 6;   // onnxruntime intra-op threads per engine
+    int32_t speaker_id = 11;
+
+    // phrase cache, 0 bytes disables it
+    size_t cache_bytes = 8 * 1024 * 1024;
+    size_t cache_max_chars = 48;  // longer phrases rarely repeat word for word
+    std::string cache_path;       // PCM pack loaded in init and written in shutdown, empty for memory only
+
+    // where speech is played, sample_rate is taken from the voice
+    AudioIOConfig output;
+    bool open_device = true;      // false skips the output entirely, replies are kept for lastOutput()
 };
 
 class TextToSpeech {
 public:
-    TextToSpeech() : tts_(nullptr), sample_rate_(0), deviceInitialized_(false) {}
+    TextToSpeech() : tts_(nullptr), sample_rate_(0), sink_(nullptr) {}
     ~TextToSpeech() { shutdown(); }
 
     bool init(const TTSConfig& config);
 
+    // one throwaway synthesis per engine, see Assistant::init
+    void warmup();
+
     // blocking: generates and plays audio, returns when done
     void speak(const std::string& text, float speed = 1.0f);
 
@@ -47,44 +62,128 @@ public:
     void queueText(const std::string& text);
     void finishStreaming();
 
+    // Barge-in: drops queued text, stops synthesis after the current sentence
+    // batch and silences the output from its next period on. Any thread;
+    // finishStreaming() still has to be called and then returns promptly.
+    void cancel();
+    bool cancelled() const { return cancel_.cancelled(); }
+
+    // phrases of the last reply that were played, 2.5 means two whole phrases
+    // and half of the third; valid after finishStreaming
+    double spokenPhrases();
+
+    // loudest period played since the last call, rms in [0, 1]; what the
+    // microphone is expected to pick up as echo
+    float takeOutputLevel() { return outputLevel_.exchange(0.0f, std::memory_order_relaxed); }
+
+    // seconds of synthesis per second of speech over the last few phrases, 0 until measured
+    double realTimeFactor() const { return rtf_.load(std::memory_order_relaxed); }
+
+    // synthesized audio waiting in the output, 0 without one
+    double bufferedSeconds() const { return sample_rate_ > 0 ? static_cast<double>(ring_.size()) / sample_rate_ : 0.0; }
+
+    // times the playback callback ran dry mid-response since startStreaming
+    uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+
+    // when the output first played speech this turn, default constructed if it has not yet
+    std::chrono::steady_clock::time_point firstAudioTime() const;
+
+    // startStreaming to first audible sample, -1 if nothing played
+    double timeToFirstAudioMs() const;
+
+    PhraseCacheStats cacheStats() const { return cache_.stats(); }
+
+    int32_t sampleRate() const { return sample_rate_; }
+
+    // the last reply's PCM when running without an output, valid after finishStreaming
+    const std::vector<int16_t>& lastOutput() const { return offline_; }
+
     void shutdown();
 
 private:
     const SherpaOnnxOfflineTts* tts_;
     int32_t sample_rate_;
 
-    void playAudio(const float* samples, int32_t n, int32_t sample_rate);
-    AudioBuffer generateAudio(const std::string& text, float speed);
-
-    // Text queue (input)
-    std::queue<std::string> textQueue_;
+    // one engine per worker, engines_[0] is tts_; sherpa-onnx does not
+    // promise that a single instance can generate from several threads
+    std::vector<const SherpaOnnxOfflineTts*> engines_;
+    std::string voice_;     // engine and model, part of every cache key
+    int32_t sid_ = 11;
+
+    PhraseCache cache_;
+    size_t cacheMaxChars_ = 0;
+    std::string cachePath_;
+
+    void playAudio(const float* samples, int32_t n);
+
+    // runs sherpa-onnx with a progress callback so each sentence batch of a
+    // phrase reaches the writer as soon as it is synthesized
+    // a non-empty cache_key stores the finished phrase in the cache
+    void synthesize(const SherpaOnnxOfflineTts* engine, uint64_t seq, const std::string& text, float speed,
+                    const std::string& cache_key);
+    static int32_t progressCallback(const float* samples, int32_t n, float progress, void* arg);
+    void appendAudio(uint64_t seq, const float* samples, int32_t n);
+
+    // Text queue (input), phrases numbered in the order they were queued
+    struct PhraseJob {
+        uint64_t seq;
+        std::string text;
+    };
+    std::queue<PhraseJob> textQueue_;
+    uint64_t nextSeq_ = 0;
     std::mutex textMutex_;
     std::condition_variable textCv_;
 
-    // Audio queue (pre-generated, ready to play)
-    std::queue<AudioBuffer> audioQueue_;
+    // Synthesized phrases waiting for their turn, workers may finish out of order
+    struct PhraseAudio {
+        std::vector<int16_t> samples;
+        bool finished = false;
+    };
+    std::map<uint64_t, PhraseAudio> phrases_;
+    bool workersDone_ = false;
     std::mutex audioMutex_;
     std::condition_variable audioCv_;
 
-    // Persistent audio device
-    ma_device device_;
-    bool deviceInitialized_;
-
-    // Current playback state (accessed by callback)
-    std::vector<int16_t> currentBuffer_;
-    std::atomic<size_t> playbackPos_{0};
-    std::mutex playbackMutex_;
+    // PCM from the generator to the playback callback, sized once in startStreaming
+    SpscRing<int16_t> ring_;
+    static constexpr int32_t RING_SECONDS = 8;
+
+    // Persistent audio output
+    AudioSink* sink_;
+
+    // Playback state read by the callback
+    std::atomic<bool> audioStarted_{false};
+    std::atomic<uint64_t> underruns_{0};
+    std::chrono::steady_clock::time_point streamStart_;
+    std::atomic<int64_t> firstAudioTicks_{0};   // steady_clock ticks, 0 until the first sample plays
+    std::atomic<uint32_t> played_{0};           // bumped by the callback after every period with audio
+    std::atomic<uint32_t> silentPeriods_{0};    // bumped after every period with none, the device has played out
+    std::atomic<uint64_t> playedSamples_{0};    // this reply, flushed samples not included
+    std::atomic<float> outputLevel_{0.0f};
+    std::atomic<float> rtf_{0.0f};               // updated by the workers under audioMutex_
+
+    // Barge-in
+    CancelToken cancel_;
+    uint64_t pushedSamples_ = 0;         // writer only, samples of this reply handed to the output
+    std::vector<uint64_t> phraseEnds_;   // writer only, pushedSamples_ at the end of each phrase
 
     // Threads
-    std::thread generatorThread_;
+    std::vector<std::thread> workers_;
+    std::thread writerThread_;
+    std::vector<int16_t> writeScratch_;
+    std::vector<int16_t> offline_;
 
     std::atomic<bool> streaming_{false};
     std::atomic<bool> textDone_{false};
-    std::atomic<bool> allDone_{false};
-
-    void generatorLoop();
-    static void audioCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
-    void fillAudioBuffer(int16_t* output, ma_uint32 frameCount);
+    std::atomic<bool> allDone_{true};     // no response in flight
+
+    void workerLoop(size_t worker);
+    void writerLoop();
+    void pushAudio(const int16_t* samples, size_t n);
+    // blocks until the sink has taken everything in the ring
+    void waitForPlayback();
+    static uint32_t audioCallback(void* user, int16_t* output, uint32_t frameCount);
+    uint32_t fillAudioBuffer(int16_t* output, uint32_t frameCount);
 };
 
 #endif
@@ -0,0 +1,89 @@
+#include "alloc_counter.h"
+
+#ifdef JARVIS_COUNT_ALLOCS
+
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t t_allocations = 0;
+
+uint64_t threadAllocationCount() {
+    return t_allocations;
+}
+
+static void* countedAlloc(std::size_t size) noexcept {
+    t_allocations++;
+    return std::malloc(size ? size : 1);
+}
+
+static void* countedAlignedAlloc(std::size_t size, std::align_val_t align) noexcept {
+    t_allocations++;
+    std::size_t alignment = static_cast<std::size_t>(align);
+    if (size == 0) size = 1;
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) == 0 ? p : nullptr;
+#endif
+}
+
+static void alignedFree(void* p) noexcept {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(std::size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    void* p = countedAlloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept   { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    void* p = countedAlignedAlloc(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) {
+    void* p = countedAlignedAlloc(size, align);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept   { return countedAlignedAlloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlignedAlloc(size, align); }
+
+void operator delete(void* p) noexcept                                { std::free(p); }
+void operator delete[](void* p) noexcept                              { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept                   { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept                 { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept         { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept       { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept                           { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept                         { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept              { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept            { alignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept    { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept  { alignedFree(p); }
+
+#else
+
+uint64_t threadAllocationCount() {
+    return 0;
+}
+
+#endif
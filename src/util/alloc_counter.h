@@ -0,0 +1,19 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// Heap allocations made by the calling thread so far. Only counts when built
+// with JARVIS_COUNT_ALLOCS, which replaces the global operator new; otherwise
+// always returns 0.
+uint64_t threadAllocationCount();
+
+constexpr bool allocationCountingEnabled() {
+#ifdef JARVIS_COUNT_ALLOCS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef CANCEL_TOKEN_H
+#define CANCEL_TOKEN_H
+
+#include <atomic>
+
+// Set from one thread, polled by the work it cancels at its own safe points
+// (once per decoded token, once per audio period). Lock free, so the audio
+// callback may read it.
+class CancelToken {
+public:
+    void cancel() { cancelled_.store(true, std::memory_order_release); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+    // only once the work it cancelled has stopped
+    void reset() { cancelled_.store(false, std::memory_order_release); }
+
+private:
+    std::atomic<bool> cancelled_{false};
+};
+
+#endif
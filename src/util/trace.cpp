@@ -0,0 +1,167 @@
+#include "trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent {
+    const char* name;
+    char phase;             // 'X' span, 'i' instant, 'M' thread name
+    uint32_t tid;
+    TraceClock::time_point start;
+    TraceClock::time_point end;
+};
+
+static const char* MARK_NAMES[] = {
+    "speech start", "capture end", "stt start", "stt end", "prefill start", "prefill end",
+    "first token", "generation end", "first phrase", "first audio", "playback end",
+};
+static_assert(sizeof(MARK_NAMES) / sizeof(MARK_NAMES[0]) == static_cast<size_t>(TurnMark::Count));
+
+struct TraceState {
+    std::mutex mutex;
+    FILE* file = nullptr;
+    TraceClock::time_point origin = TraceClock::now();
+    std::vector<TraceEvent> events;
+
+    TraceClock::time_point marks[static_cast<size_t>(TurnMark::Count)];
+    bool marked[static_cast<size_t>(TurnMark::Count)] = {};
+    double totals[static_cast<size_t>(TurnCount::Count)] = {};
+};
+
+static TraceState& state() {
+    static TraceState s;
+    return s;
+}
+
+static uint32_t threadId() {
+    static std::atomic<uint32_t> next{1};
+    thread_local uint32_t id = next++;
+    return id;
+}
+
+static double micros(const TraceState& s, TraceClock::time_point t) {
+    return std::chrono::duration<double, std::micro>(t - s.origin).count();
+}
+
+static double msBetween(const TraceState& s, TurnMark from, TurnMark to) {
+    size_t a = static_cast<size_t>(from), b = static_cast<size_t>(to);
+    if (!s.marked[a] || !s.marked[b]) return -1.0;
+    return std::chrono::duration<double, std::milli>(s.marks[b] - s.marks[a]).count();
+}
+
+bool Trace::open(const std::string& path) {
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.file) fclose(s.file);
+
+    s.file = fopen(path.c_str(), "w");
+    if (!s.file) {
+        fprintf(stderr, "Failed to open trace file %s\n", path.c_str());
+        return false;
+    }
+    // the array format allows a missing closing bracket, so a crash still
+    // leaves a loadable file
+    fputs("[\n", s.file);
+    s.events.reserve(4096);
+    return true;
+}
+
+void Trace::close() {
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.file) {
+        fputs("{}]\n", s.file);
+        fclose(s.file);
+        s.file = nullptr;
+    }
+}
+
+void Trace::beginTurn() {
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (bool& m : s.marked) m = false;
+    for (double& t : s.totals) t = 0.0;
+}
+
+TurnSummary Trace::endTurn() {
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    for (size_t i = 0; i < static_cast<size_t>(TurnMark::Count); i++) {
+        if (s.marked[i]) s.events.push_back({ MARK_NAMES[i], 'i', 0, s.marks[i], s.marks[i] });
+    }
+
+    if (s.file) {
+        for (const TraceEvent& e : s.events) {
+            if (e.phase == 'M') {
+                fprintf(s.file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+                        e.tid, e.name);
+            } else if (e.phase == 'X') {
+                fprintf(s.file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.1f,\"dur\":%.1f},\n",
+                        e.name, e.tid, micros(s, e.start), micros(s, e.end) - micros(s, e.start));
+            } else {
+                // turn marks go on a track of their own
+                fprintf(s.file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.1f},\n",
+                        e.name, e.tid ? 't' : 'p', e.tid, micros(s, e.start));
+            }
+        }
+        fflush(s.file);
+    }
+    s.events.clear();
+
+    TurnSummary sum;
+    sum.ttft_ms = msBetween(s, TurnMark::CaptureEnd, TurnMark::FirstToken);
+    sum.ttfa_ms = msBetween(s, TurnMark::CaptureEnd, TurnMark::FirstAudio);
+    sum.stt_ms = msBetween(s, TurnMark::SttStart, TurnMark::SttEnd);
+    sum.prefill_ms = msBetween(s, TurnMark::PrefillStart, TurnMark::PrefillEnd);
+
+    const double* totals = s.totals;
+    sum.tokens = static_cast<int>(totals[static_cast<size_t>(TurnCount::Tokens)]);
+    double genMs = msBetween(s, TurnMark::FirstToken, TurnMark::GenerationEnd);
+    if (genMs > 0.0 && sum.tokens > 1) sum.tokens_per_second = (sum.tokens - 1) * 1000.0 / genMs;
+
+    double utterance = totals[static_cast<size_t>(TurnCount::UtteranceSeconds)];
+    if (utterance > 0.0) sum.stt_rtf = totals[static_cast<size_t>(TurnCount::SttSeconds)] / utterance;
+    double speech = totals[static_cast<size_t>(TurnCount::SpeechSeconds)];
+    if (speech > 0.0) sum.tts_rtf = totals[static_cast<size_t>(TurnCount::SynthSeconds)] / speech;
+    return sum;
+}
+
+void Trace::mark(TurnMark m, TraceClock::time_point t) {
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    size_t i = static_cast<size_t>(m);
+    if (!s.marked[i]) {
+        s.marks[i] = t;
+        s.marked[i] = true;
+    }
+}
+
+void Trace::count(TurnCount c, double value) {
+    TraceState& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.totals[static_cast<size_t>(c)] += value;
+}
+
+void Trace::instant(const char* name, TraceClock::time_point t) {
+    TraceState& s = state();
+    uint32_t tid = threadId();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.events.push_back({ name, 'i', tid, t, t });
+}
+
+void Trace::complete(const char* name, TraceClock::time_point start, TraceClock::time_point end) {
+    TraceState& s = state();
+    uint32_t tid = threadId();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.events.push_back({ name, 'X', tid, start, end });
+}
+
+void Trace::setThreadName(const char* name) {
+    TraceState& s = state();
+    uint32_t tid = threadId();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.events.push_back({ name, 'M', tid, {}, {} });
+}
@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Turn timeline for the voice pipeline, written as Chrome trace JSON that
+// chrome://tracing and Perfetto open directly. The TRACE_* macros compile to
+// nothing unless the build defines JARVIS_TRACE (cmake -DJARVIS_TRACE=ON).
+
+using TraceClock = std::chrono::steady_clock;
+
+// points in a turn, each recorded once per turn (the first call wins)
+enum class TurnMark {
+    SpeechStart,
+    CaptureEnd,
+    SttStart,
+    SttEnd,
+    PrefillStart,
+    PrefillEnd,
+    FirstToken,
+    GenerationEnd,
+    FirstPhrase,
+    FirstAudio,
+    PlaybackEnd,
+    Count
+};
+
+// totals accumulated over a turn
+enum class TurnCount {
+    Tokens,
+    UtteranceSeconds,   // captured speech fed to whisper
+    SttSeconds,         // time spent in whisper
+    SynthSeconds,       // time spent in the TTS engines
+    SpeechSeconds,      // audio the TTS produced
+    Count
+};
+
+struct TurnSummary {
+    double ttft_ms = -1.0;          // end of capture to first token
+    double ttfa_ms = -1.0;          // end of capture to first audible sample
+    double stt_ms = -1.0;           // finishing the transcript after capture ended
+    double prefill_ms = -1.0;
+    double tokens_per_second = 0.0;
+    double stt_rtf = 0.0;           // whisper time / utterance length
+    double tts_rtf = 0.0;           // synthesis time / speech length
+    int tokens = 0;
+};
+
+class Trace {
+public:
+    // start a trace file; without this events are only used for the summary
+    static bool open(const std::string& path);
+    static void close();
+
+    static void beginTurn();
+    // writes the turn's events to the file and returns its summary
+    static TurnSummary endTurn();
+
+    static void mark(TurnMark m, TraceClock::time_point t = TraceClock::now());
+    static void count(TurnCount c, double value);
+
+    static void instant(const char* name, TraceClock::time_point t = TraceClock::now());
+    static void complete(const char* name, TraceClock::time_point start, TraceClock::time_point end);
+
+    // label for the calling thread's track in the viewer
+    static void setThreadName(const char* name);
+};
+
+// span from construction to destruction, optionally added to a turn total
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, TurnCount total = TurnCount::Count)
+        : name_(name), total_(total), start_(TraceClock::now()) {}
+    ~TraceScope() {
+        TraceClock::time_point end = TraceClock::now();
+        Trace::complete(name_, start_, end);
+        if (total_ != TurnCount::Count) {
+            Trace::count(total_, std::chrono::duration<double>(end - start_).count());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    TurnCount total_;
+    TraceClock::time_point start_;
+};
+
+constexpr bool traceEnabled() {
+#ifdef JARVIS_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef JARVIS_TRACE
+#define TRACE_SCOPE(name)                 TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#define TRACE_SCOPE_TOTAL(name, total)    TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name, total)
+#define TRACE_INSTANT(name)               Trace::instant(name)
+#define TRACE_MARK(m)                     Trace::mark(m)
+#define TRACE_MARK_AT(m, t)               Trace::mark(m, t)
+#define TRACE_COUNT(c, value)             Trace::count(c, value)
+#define TRACE_THREAD_NAME(name)           Trace::setThreadName(name)
+#else
+#define TRACE_SCOPE(name)                 ((void)0)
+#define TRACE_SCOPE_TOTAL(name, total)    ((void)0)
+#define TRACE_INSTANT(name)               ((void)0)
+#define TRACE_MARK(m)                     ((void)0)
+#define TRACE_MARK_AT(m, t)               ((void)0)
+#define TRACE_COUNT(c, value)             ((void)0)
+#define TRACE_THREAD_NAME(name)           ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,370 @@
+// Offline pipeline benchmark, no audio devices needed:
+//   jarvis_bench --corpus <file.wav|dir> [--whisper <model>] [--llm <gguf>] [--draft <gguf>]
+//                [--kokoro <dir> | --piper <dir>] [--seed 42] [--max-tokens 256] [--repeat 1]
+//                [--gpu-layers 99] [--tts-workers 1] [--tts-threads 6] [--tts-cache 0]
+//                [--json <out.json>] [--wav-out <dir>] [--no-warmup]
+// Every utterance goes through Whisper, the LLM (fixed seed, history cleared
+// per utterance) and TTS into memory. Per-stage p50/p95/p99 and throughput are
+// written as JSON to --json or stdout; progress goes to stderr.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/audio/wav_io.h"
+#include "../src/llm/text_inference.h"
+#include "../src/pipeline/phrase_chunker.h"
+#include "../src/transcribe/transcribe.h"
+#include "../src/tts/tts.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char* BENCH_SYSTEM_PROMPT =
+    "<|im_start|>system\n"
+    "You are Jarvis, a voice assistant. Answer in a few short spoken sentences, plain text only."
+    "<|im_end|>\n";
+
+static double ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size() + 2);
+    for (unsigned char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
+    }
+    return out;
+}
+
+// FNV-1a of the reply text, changes whenever the model's output does
+static uint64_t textHash(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+struct UtteranceResult {
+    std::string file;
+    double audio_s = 0.0;
+    double stt_ms = 0.0;
+    double prefill_ms = 0.0;
+    double ttft_ms = 0.0;       // prompt submitted to first token
+    double generate_ms = 0.0;
+    int tokens = 0;
+    double tts_tail_ms = 0.0;   // last token to last sample synthesized
+    double ttfa_ms = 0.0;       // start of STT to first synthesized sample
+    double total_ms = 0.0;
+    double speech_s = 0.0;
+    std::string transcript;
+    std::string reply;
+};
+
+static void usage() {
+    std::cerr << "usage: jarvis_bench --corpus <file.wav|dir> [--whisper <model>] [--llm <gguf>] [--draft <gguf>]\n"
+                 "                    [--kokoro <dir> | --piper <dir>] [--seed 42] [--max-tokens 256] [--repeat 1]\n"
+                 "                    [--gpu-layers 99] [--tts-workers 1] [--tts-threads 6] [--tts-cache 0]\n"
+                 "                    [--json <out.json>] [--wav-out <dir>] [--no-warmup]\n";
+}
+
+int main(int argc, char** argv) {
+    std::string corpus;
+    std::string whisperModel = "models/ggml-medium-q8_0.bin";
+    std::string llmModel = "models/Qwen3-VL-4B-Instruct-Q4_1.gguf";
+    std::string draftModel;
+    std::string kokoroDir = "models/kokoro-int8-multi-lang-v1_0";
+    std::string piperDir;
+    std::string jsonPath;
+    std::string wavOut;
+    uint32_t seed = 42;
+    int maxTokens = 256;
+    int repeat = 1;
+    int gpuLayers = 99;
+    int ttsWorkers = 1;
+    int ttsThreads = 6;
+    size_t ttsCacheBytes = 0;   // off by default so every run synthesizes everything
+    bool warmup = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-warmup") { warmup = false; continue; }
+        if (i + 1 >= argc) { usage(); return 1; }
+        const char* value = argv[++i];
+        if      (arg == "--corpus")      corpus = value;
+        else if (arg == "--whisper")     whisperModel = value;
+        else if (arg == "--llm")         llmModel = value;
+        else if (arg == "--draft")       draftModel = value;
+        else if (arg == "--kokoro")      kokoroDir = value;
+        else if (arg == "--piper")       piperDir = value;
+        else if (arg == "--seed")        seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+        else if (arg == "--max-tokens")  maxTokens = std::atoi(value);
+        else if (arg == "--repeat")      repeat = std::max(1, std::atoi(value));
+        else if (arg == "--gpu-layers")  gpuLayers = std::atoi(value);
+        else if (arg == "--tts-workers") ttsWorkers = std::atoi(value);
+        else if (arg == "--tts-threads") ttsThreads = std::atoi(value);
+        else if (arg == "--tts-cache")   ttsCacheBytes = std::strtoul(value, nullptr, 10);
+        else if (arg == "--json")        jsonPath = value;
+        else if (arg == "--wav-out")     wavOut = value;
+        else { usage(); return 1; }
+    }
+
+    if (corpus.empty()) {
+        usage();
+        return 1;
+    }
+
+    // corpus: one file or every .wav under a directory, sorted for stable output
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (std::filesystem::is_directory(corpus, ec)) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(corpus, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(corpus);
+    }
+    if (files.empty()) {
+        std::cerr << "No WAV files in " << corpus << "\n";
+        return 1;
+    }
+
+    // --- engines ---
+
+    // the JSON report goes to stdout, the engines keep to stderr
+    Transcribe stt;
+    stt.setQuiet(true);
+    if (!stt.init(whisperModel)) {
+        std::cerr << "Failed to init Whisper\n";
+        return 1;
+    }
+
+    TextInferenceConfig llmConfig;
+    llmConfig.gpu_layers = gpuLayers;
+    llmConfig.n_ctx = 4096;
+    llmConfig.seed = seed;
+    llmConfig.draft_model_path = draftModel;
+    TextInference llm;
+    if (!llm.init(llmModel, llmConfig) || !llm.setSystemPrompt(BENCH_SYSTEM_PROMPT, "cache")) {
+        std::cerr << "Failed to init LLM\n";
+        return 1;
+    }
+
+    TTSConfig ttsConfig;
+    if (!piperDir.empty()) {
+        std::filesystem::path dir(piperDir);
+        ttsConfig.engine = TTSEngine::Piper;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+            if (entry.path().extension() == ".onnx") ttsConfig.model_path = entry.path().string();
+        }
+        ttsConfig.tokens_path = (dir / "tokens.txt").string();
+        ttsConfig.data_dir = (dir / "espeak-ng-data").string();
+    } else {
+        std::filesystem::path dir(kokoroDir);
+        ttsConfig.engine = TTSEngine::Kokoro;
+        ttsConfig.model_path = (dir / "model.int8.onnx").string();
+        ttsConfig.tokens_path = (dir / "tokens.txt").string();
+        ttsConfig.data_dir = (dir / "espeak-ng-data").string();
+        ttsConfig.voices_path = (dir / "voices.bin").string();
+    }
+    ttsConfig.num_workers = ttsWorkers;
+    ttsConfig.threads_per_worker = ttsThreads;
+    ttsConfig.cache_bytes = ttsCacheBytes;
+    ttsConfig.open_device = false;
+    TextToSpeech tts;
+    if (!tts.init(ttsConfig)) {
+        std::cerr << "Failed to init TTS\n";
+        return 1;
+    }
+
+    if (warmup) {
+        stt.warmup();
+        llm.warmup();
+        tts.warmup();
+    }
+
+    if (!wavOut.empty()) std::filesystem::create_directories(wavOut, ec);
+
+    // --- run ---
+
+    std::vector<UtteranceResult> results;
+    std::vector<float> audio;
+    auto benchStart = Clock::now();
+
+    for (int r = 0; r < repeat; r++) {
+        for (const std::string& file : files) {
+            if (!readWav(file, 16000, audio)) continue;
+
+            UtteranceResult res;
+            res.file = file;
+            res.audio_s = audio.size() / 16000.0;
+
+            llm.clearHistory();
+
+            auto t0 = Clock::now();
+            res.transcript = stt.transcribe(audio);
+            auto tStt = Clock::now();
+            res.stt_ms = ms(t0, tStt);
+
+            std::string prompt =
+                "<|im_start|>user\n" + res.transcript + "\n<|im_end|>\n<|im_start|>assistant\n";
+
+            tts.startStreaming();
+            // same phrase boundaries the assistant uses; without an output
+            // nothing is buffered, so it keeps cutting at clauses
+            PhraseChunker chunker;
+            PhraseChunk phrase;
+            Clock::time_point firstToken{};
+            auto tPrompt = Clock::now();
+
+            res.tokens = llm.generateStream(prompt, maxTokens, [&](std::string_view tok) {
+                if (firstToken == Clock::time_point{}) firstToken = Clock::now();
+                res.reply += tok;
+                if (tok.find("<|") != std::string_view::npos) return;
+                chunker.setFeedback(tts.realTimeFactor(), tts.bufferedSeconds());
+                chunker.append(tok);
+                while (chunker.next(phrase)) tts.queueText(phrase.text);
+            });
+            auto tGen = Clock::now();
+            while (chunker.finish(phrase)) tts.queueText(phrase.text);
+
+            tts.finishStreaming();
+            auto tEnd = Clock::now();
+
+            res.prefill_ms = llm.lastPrefill().total_ms;
+            res.ttft_ms = firstToken != Clock::time_point{} ? ms(tPrompt, firstToken) : -1.0;
+            res.generate_ms = llm.lastGeneration().ms;
+            res.tts_tail_ms = ms(tGen, tEnd);
+            res.ttfa_ms = tts.timeToFirstAudioMs() >= 0.0 ? ms(t0, tts.firstAudioTime()) : -1.0;
+            res.total_ms = ms(t0, tEnd);
+            res.speech_s = static_cast<double>(tts.lastOutput().size()) / tts.sampleRate();
+
+            if (!wavOut.empty() && r == 0) {
+                std::filesystem::path out = std::filesystem::path(wavOut) /
+                                            (std::filesystem::path(file).stem().string() + ".reply.wav");
+                writeWav(out.string(), tts.lastOutput().data(), tts.lastOutput().size(), tts.sampleRate());
+            }
+
+            fprintf(stderr, "%s: stt %.0f ms, ttft %.0f ms, %d tokens, ttfa %.0f ms, total %.0f ms\n",
+                    file.c_str(), res.stt_ms, res.ttft_ms, res.tokens, res.ttfa_ms, res.total_ms);
+            results.push_back(std::move(res));
+        }
+    }
+
+    double wallS = ms(benchStart, Clock::now()) / 1000.0;
+    if (results.empty()) {
+        std::cerr << "No utterances decoded\n";
+        return 1;
+    }
+
+    // --- report ---
+
+    FILE* out = stdout;
+    if (!jsonPath.empty()) {
+        out = fopen(jsonPath.c_str(), "w");
+        if (!out) {
+            std::cerr << "Failed to write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+
+    struct Stage {
+        const char* name;
+        double UtteranceResult::* field;
+    };
+    const Stage stages[] = {
+        { "stt_ms", &UtteranceResult::stt_ms },
+        { "prefill_ms", &UtteranceResult::prefill_ms },
+        { "ttft_ms", &UtteranceResult::ttft_ms },
+        { "generate_ms", &UtteranceResult::generate_ms },
+        { "tts_tail_ms", &UtteranceResult::tts_tail_ms },
+        { "ttfa_ms", &UtteranceResult::ttfa_ms },
+        { "total_ms", &UtteranceResult::total_ms },
+    };
+
+    double audioS = 0.0, speechS = 0.0, sttMs = 0.0, genMs = 0.0;
+    long tokens = 0;
+    for (const UtteranceResult& r : results) {
+        audioS += r.audio_s;
+        speechS += r.speech_s;
+        sttMs += r.stt_ms;
+        genMs += r.generate_ms;
+        tokens += r.tokens;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": {\"whisper\": \"%s\", \"llm\": \"%s\", \"draft\": \"%s\", \"tts\": \"%s\", "
+                 "\"seed\": %u, \"max_tokens\": %d, \"repeat\": %d, \"tts_workers\": %d, \"tts_threads\": %d},\n",
+            jsonEscape(whisperModel).c_str(), jsonEscape(llmModel).c_str(), jsonEscape(draftModel).c_str(),
+            jsonEscape(ttsConfig.model_path).c_str(), seed, maxTokens, repeat, ttsWorkers, ttsThreads);
+
+    fprintf(out, "  \"stages\": {\n");
+    for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); s++) {
+        std::vector<double> v;
+        double sum = 0.0;
+        for (const UtteranceResult& r : results) {
+            double x = r.*(stages[s].field);
+            if (x < 0.0) continue;   // stage never happened, e.g. an empty reply
+            v.push_back(x);
+            sum += x;
+        }
+        fprintf(out, "    \"%s\": {\"n\": %zu, \"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f}%s\n",
+                stages[s].name, v.size(), v.empty() ? 0.0 : sum / v.size(),
+                percentile(v, 0.50), percentile(v, 0.95), percentile(v, 0.99),
+                s + 1 < sizeof(stages) / sizeof(stages[0]) ? "," : "");
+    }
+    fprintf(out, "  },\n");
+
+    fprintf(out, "  \"throughput\": {\"utterances\": %zu, \"wall_s\": %.3f, \"utterances_per_s\": %.4f, "
+                 "\"tokens_per_s\": %.2f, \"stt_rtf\": %.4f, \"speech_s\": %.3f},\n",
+            results.size(), wallS, results.size() / wallS,
+            genMs > 0.0 ? tokens * 1000.0 / genMs : 0.0,
+            audioS > 0.0 ? sttMs / 1000.0 / audioS : 0.0, speechS);
+
+    fprintf(out, "  \"utterances\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const UtteranceResult& r = results[i];
+        fprintf(out, "    {\"file\": \"%s\", \"audio_s\": %.3f, \"stt_ms\": %.2f, \"prefill_ms\": %.2f, "
+                     "\"ttft_ms\": %.2f, \"generate_ms\": %.2f, \"tokens\": %d, \"tts_tail_ms\": %.2f, "
+                     "\"ttfa_ms\": %.2f, \"total_ms\": %.2f, \"speech_s\": %.3f, "
+                     "\"reply_hash\": \"%016llx\", \"transcript\": \"%s\"}%s\n",
+                jsonEscape(r.file).c_str(), r.audio_s, r.stt_ms, r.prefill_ms, r.ttft_ms, r.generate_ms,
+                r.tokens, r.tts_tail_ms, r.ttfa_ms, r.total_ms, r.speech_s,
+                static_cast<unsigned long long>(textHash(r.reply)), jsonEscape(r.transcript).c_str(),
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
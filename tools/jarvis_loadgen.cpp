@@ -0,0 +1,263 @@
+// Load generator for jarvis --server:
+//   jarvis_loadgen [--port 8765] [--clients 4] [--turns 5] [--prompts <file>]
+//                  [--think-ms 0] [--voice 0] [--json <out.json>]
+// Every client opens its own session and sends --turns messages one after
+// the other, waiting --think-ms between a reply and the next message. The
+// first --voice clients ask for voice priority, the rest stay text.
+// Latency percentiles, per class and overall, the server's batch metrics
+// and aggregate throughput are written as JSON to --json or stdout;
+// progress goes to stderr.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/server/local_socket.h"
+
+using Clock = std::chrono::steady_clock;
+
+static const char* DEFAULT_PROMPTS[] = {
+    "What's a good way to start the morning?",
+    "Explain how a rainbow forms.",
+    "Give me a quick dinner idea with rice and eggs.",
+    "Why is the sky blue?",
+    "Tell me a short story about a lighthouse keeper.",
+    "How do I keep basil alive indoors?",
+    "What should I pack for a weekend hike?",
+    "Summarize how vaccines work in a few sentences.",
+};
+
+struct TurnResult {
+    int client = 0;
+    bool voice = false;
+    int tokens = 0;
+    int prompt = 0;
+    double queue_ms = 0.0;      // server side, submit to prefill
+    double ttft_ms = -1.0;      // server side, submit to first token
+    double server_ms = 0.0;
+    double total_ms = 0.0;      // client side, message sent to D line
+};
+
+static double ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+// "D tokens=12 prompt=30 queue_ms=0.4 ttft_ms=85.0 total_ms=640.2"
+static bool parseDone(const std::string& line, TurnResult& r) {
+    return sscanf(line.c_str(), "D tokens=%d prompt=%d queue_ms=%lf ttft_ms=%lf total_ms=%lf",
+                  &r.tokens, &r.prompt, &r.queue_ms, &r.ttft_ms, &r.server_ms) == 5;
+}
+
+static void usage() {
+    std::cerr << "usage: jarvis_loadgen [--port 8765] [--clients 4] [--turns 5] [--prompts <file>]\n"
+                 "                      [--think-ms 0] [--voice 0] [--json <out.json>]\n";
+}
+
+int main(int argc, char** argv) {
+    int port = 8765;
+    int clients = 4;
+    int turns = 5;
+    int thinkMs = 0;
+    int voiceClients = 0;
+    std::string promptsPath;
+    std::string jsonPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        const char* value = argv[++i];
+        if      (arg == "--port")     port = std::atoi(value);
+        else if (arg == "--clients")  clients = std::max(1, std::atoi(value));
+        else if (arg == "--turns")    turns = std::max(1, std::atoi(value));
+        else if (arg == "--prompts")  promptsPath = value;
+        else if (arg == "--think-ms") thinkMs = std::max(0, std::atoi(value));
+        else if (arg == "--voice")    voiceClients = std::max(0, std::atoi(value));
+        else if (arg == "--json")     jsonPath = value;
+        else { usage(); return 1; }
+    }
+
+    std::vector<std::string> prompts;
+    if (!promptsPath.empty()) {
+        std::ifstream file(promptsPath);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty()) prompts.push_back(line);
+        }
+        if (prompts.empty()) {
+            std::cerr << "No prompts in " << promptsPath << "\n";
+            return 1;
+        }
+    } else {
+        prompts.assign(std::begin(DEFAULT_PROMPTS), std::end(DEFAULT_PROMPTS));
+    }
+
+    std::mutex mutex;
+    std::vector<TurnResult> results;
+    int rejected = 0;
+    int failed = 0;
+
+    auto client = [&](int c) {
+        LocalSocket socket;
+        std::string line;
+        if (!socket.connect(static_cast<uint16_t>(port)) || !socket.readLine(line) || line.rfind("S ", 0) != 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (line.rfind("E ", 0) == 0) rejected++; else failed++;
+            return;
+        }
+
+        const bool voice = c < voiceClients;
+        if (voice && (!socket.send("/voice\n") || !socket.readLine(line) || line != "O")) {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed++;
+            return;
+        }
+
+        for (int t = 0; t < turns; t++) {
+            // clients start at different prompts so the batch mixes lengths
+            const std::string& prompt = prompts[(c + t) % prompts.size()];
+            TurnResult r;
+            r.client = c;
+            r.voice = voice;
+
+            auto start = Clock::now();
+            std::string reply;
+            std::string done;
+            if (!socket.send(prompt + "\n") || !socket.readLine(reply) || !socket.readLine(done) ||
+                reply.rfind("R ", 0) != 0 || !parseDone(done, r)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed++;
+                return;
+            }
+            r.total_ms = ms(start, Clock::now());
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.push_back(r);
+                fprintf(stderr, "client %d (%s) turn %d: %d tokens, ttft %.0f ms, %.0f ms\n",
+                        c, voice ? "voice" : "text", t, r.tokens, r.ttft_ms, r.total_ms);
+            }
+            if (thinkMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(thinkMs));
+        }
+        socket.send("/quit\n");
+    };
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) threads.emplace_back(client, c);
+    for (std::thread& t : threads) t.join();
+    double wallS = ms(start, Clock::now()) / 1000.0;
+
+    // the server's view of the run, "M key=value ..."
+    std::string serverStats;
+    {
+        LocalSocket socket;
+        std::string line;
+        if (socket.connect(static_cast<uint16_t>(port)) && socket.readLine(line) && line.rfind("S ", 0) == 0 &&
+            socket.send("/stats\n") && socket.readLine(line) && line.rfind("M ", 0) == 0) {
+            serverStats = line.substr(2);
+        }
+        socket.send("/quit\n");
+    }
+
+    if (results.empty()) {
+        std::cerr << "No replies from 127.0.0.1:" << port << " (" << rejected << " rejected, "
+                  << failed << " failed)\n";
+        return 1;
+    }
+
+    // --- report ---
+
+    FILE* out = stdout;
+    if (!jsonPath.empty()) {
+        out = fopen(jsonPath.c_str(), "w");
+        if (!out) {
+            std::cerr << "Failed to write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+
+    struct Metric {
+        const char* name;
+        double TurnResult::* field;
+    };
+    const Metric metrics[] = {
+        { "queue_ms", &TurnResult::queue_ms },
+        { "ttft_ms", &TurnResult::ttft_ms },
+        { "server_ms", &TurnResult::server_ms },
+        { "total_ms", &TurnResult::total_ms },
+    };
+
+    long tokens = 0;
+    double perReplyRate = 0.0;
+    for (const TurnResult& r : results) {
+        tokens += r.tokens;
+        if (r.server_ms > 0.0) perReplyRate += r.tokens * 1000.0 / r.server_ms;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": {\"port\": %d, \"clients\": %d, \"turns\": %d, \"think_ms\": %d, \"voice\": %d, \"prompts\": %zu},\n",
+            port, clients, turns, thinkMs, std::min(voiceClients, clients), prompts.size());
+
+    // all turns, then each class on its own
+    const char* groups[] = { "latency", "latency_voice", "latency_text" };
+    for (int g = 0; g < 3; g++) {
+        fprintf(out, "  \"%s\": {\n", groups[g]);
+        for (size_t m = 0; m < sizeof(metrics) / sizeof(metrics[0]); m++) {
+            std::vector<double> v;
+            double sum = 0.0;
+            for (const TurnResult& r : results) {
+                if ((g == 1 && !r.voice) || (g == 2 && r.voice)) continue;
+                double x = r.*(metrics[m].field);
+                if (x < 0.0) continue;   // no tokens, no ttft
+                v.push_back(x);
+                sum += x;
+            }
+            fprintf(out, "    \"%s\": {\"n\": %zu, \"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f}%s\n",
+                    metrics[m].name, v.size(), v.empty() ? 0.0 : sum / v.size(),
+                    percentile(v, 0.50), percentile(v, 0.95), percentile(v, 0.99),
+                    m + 1 < sizeof(metrics) / sizeof(metrics[0]) ? "," : "");
+        }
+        fprintf(out, "  },\n");
+    }
+
+    // server metrics as numbers, keys as the server named them
+    fprintf(out, "  \"server\": {");
+    {
+        size_t pos = 0;
+        bool first = true;
+        while (pos < serverStats.size()) {
+            size_t end = serverStats.find(' ', pos);
+            if (end == std::string::npos) end = serverStats.size();
+            std::string field = serverStats.substr(pos, end - pos);
+            size_t eq = field.find('=');
+            if (eq != std::string::npos) {
+                fprintf(out, "%s\"%s\": %s", first ? "" : ", ", field.substr(0, eq).c_str(), field.substr(eq + 1).c_str());
+                first = false;
+            }
+            pos = end + 1;
+        }
+    }
+    fprintf(out, "},\n");
+
+    fprintf(out, "  \"throughput\": {\"replies\": %zu, \"rejected\": %d, \"failed\": %d, \"wall_s\": %.3f, "
+                 "\"replies_per_s\": %.3f, \"tokens_per_s\": %.2f, \"per_session_tokens_per_s\": %.2f}\n",
+            results.size(), rejected, failed, wallS, results.size() / wallS, tokens / wallS,
+            perReplyRate / results.size());
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+    return 0;
+}
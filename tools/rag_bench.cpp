@@ -0,0 +1,225 @@
+// Recall@k vs latency of HNSW, SIMD brute force and HNSW + rerank against exact search:
+//   jarvis_rag_bench --index <index_dir> [--model <embedding.gguf> --queries <file>]
+//                    [--k 5] [--samples 200]
+// Without a queries file, stored chunk vectors are used as queries. Also prints
+// ns per dot product for every kernel set the CPU supports.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/rag/embedder.h"
+#include "../src/rag/exact_search.h"
+#include "../src/rag/fp16.h"
+#include "../src/rag/hnsw_index.h"
+#include "../src/rag/retriever.h"
+#include "../src/rag/vector_store.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double micros(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+// exact top-k by inner product over every stored vector
+static void exactSearch(const VectorStore& store, const float* q, size_t k, std::vector<size_t>& out) {
+    std::vector<std::pair<float, size_t>> scored(store.size());
+    std::vector<float> v(store.dim());
+    for (size_t i = 0; i < store.size(); i++) {
+        store.vector(i, v.data());
+        float dot = 0.0f;
+        for (int d = 0; d < store.dim(); d++) dot += q[d] * v[d];
+        scored[i] = { dot, i };
+    }
+    k = std::min(k, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + k, scored.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    out.clear();
+    for (size_t i = 0; i < k; i++) out.push_back(scored[i].second);
+}
+
+int main(int argc, char** argv) {
+    std::string indexDir, model, queriesPath;
+    size_t k = 5;
+    size_t samples = 200;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        const char* value = argv[i + 1];
+        if      (arg == "--index")   indexDir = value;
+        else if (arg == "--model")   model = value;
+        else if (arg == "--queries") queriesPath = value;
+        else if (arg == "--k")       k = std::strtoul(value, nullptr, 10);
+        else if (arg == "--samples") samples = std::strtoul(value, nullptr, 10);
+    }
+
+    if (indexDir.empty()) {
+        std::cerr << "usage: jarvis_rag_bench --index <index_dir> [--model <embedding.gguf> --queries <file>] [--k 5] [--samples 200]\n";
+        return 1;
+    }
+
+    std::filesystem::path dir(indexDir);
+    VectorStore store;
+    HnswIndex index;
+    auto openStart = Clock::now();
+    if (!store.open((dir / RAG_STORE_FILE).string()) ||
+        !index.load((dir / RAG_INDEX_FILE).string(), store.dim())) {
+        return 1;
+    }
+    auto openEnd = Clock::now();
+
+    const int dim = store.dim();
+    std::vector<float> queries;
+
+    if (!queriesPath.empty() && !model.empty()) {
+        Embedder embedder;
+        if (!embedder.init(model, 99)) return 1;
+        std::ifstream in(queriesPath);
+        std::string line;
+        std::vector<float> vec;
+        while (std::getline(in, line)) {
+            if (line.empty() || !embedder.embed(line, vec)) continue;
+            queries.insert(queries.end(), vec.begin(), vec.end());
+        }
+    } else {
+        size_t stride = std::max<size_t>(1, store.size() / samples);
+        std::vector<float> vec(dim);
+        for (size_t i = 0; i < store.size(); i += stride) {
+            store.vector(i, vec.data());
+            queries.insert(queries.end(), vec.begin(), vec.end());
+        }
+    }
+
+    const size_t nq = queries.size() / dim;
+    if (nq == 0) {
+        std::cerr << "no queries\n";
+        return 1;
+    }
+
+    // ground truth, plain float math over dequantized vectors
+    std::vector<std::vector<size_t>> truth(nq);
+    for (size_t q = 0; q < nq; q++) {
+        exactSearch(store, queries.data() + q * dim, k, truth[q]);
+    }
+
+    auto recallOf = [&](size_t q, const std::vector<SearchResult>& hits) {
+        size_t found = 0;
+        for (const SearchResult& hit : hits) {
+            if (std::find(truth[q].begin(), truth[q].end(), hit.id) != truth[q].end()) found++;
+        }
+        return truth[q].empty() ? 1.0 : static_cast<double>(found) / truth[q].size();
+    };
+
+    auto report = [&](const char* label, const std::vector<double>& us, double recall) {
+        printf("%-24s %10.4f %10.1f %10.1f\n", label, recall / nq, percentile(us, 0.5), percentile(us, 0.99));
+    };
+
+    printf("%zu %s vectors, %d dims, %zu queries, k=%zu, opened in %.1f ms\n\n",
+           store.size(), VectorStore::typeName(store.type()), dim, nq, k, micros(openStart, openEnd) / 1000.0);
+
+    // raw kernel throughput on synthetic vectors of the same width
+    const DotKernels* kernelSets[4];
+    const size_t nKernels = availableDotKernels(kernelSets, 4);
+    {
+        std::vector<float> a(dim), b(dim);
+        std::vector<uint16_t> h(dim);
+        std::vector<int8_t> ia(dim), ib(dim);
+        for (int d = 0; d < dim; d++) {
+            a[d] = std::sin(d * 0.37f);
+            b[d] = std::cos(d * 0.11f);
+            h[d] = fp32ToFp16(b[d]);
+        }
+        quantizeI8(a.data(), dim, ia.data());
+        quantizeI8(b.data(), dim, ib.data());
+
+        const int reps = 200000;
+        printf("%-24s %10s %10s %10s\n", "kernel ns/dot", "f32", "f16", "i8");
+        for (size_t ki = 0; ki < nKernels; ki++) {
+            const DotKernels& kern = *kernelSets[ki];
+            volatile float sink = 0.0f;
+            auto t0 = Clock::now();
+            for (int r = 0; r < reps; r++) sink = sink + kern.f32(a.data(), b.data(), dim);
+            auto t1 = Clock::now();
+            for (int r = 0; r < reps; r++) sink = sink + kern.f16(a.data(), h.data(), dim);
+            auto t2 = Clock::now();
+            for (int r = 0; r < reps; r++) sink = sink + static_cast<float>(kern.i8(ia.data(), ib.data(), dim));
+            auto t3 = Clock::now();
+            printf("%-24s %10.1f %10.1f %10.1f\n", kern.name,
+                   micros(t0, t1) * 1000.0 / reps, micros(t1, t2) * 1000.0 / reps, micros(t2, t3) * 1000.0 / reps);
+        }
+        printf("\n");
+    }
+
+    printf("%-24s %10s %10s %10s\n", "search", "recall@k", "p50 us", "p99 us");
+
+    ExactSearcher exact;
+    exact.init(&store, store.type() == VectorType::I8 ? Metric::Cosine : Metric::Dot);
+
+    std::vector<SearchResult> hits;
+    std::vector<SearchResult> candidates;
+    char label[64];
+
+    for (size_t ki = 0; ki < nKernels; ki++) {
+        exact.setKernels(kernelSets[ki]);
+        std::vector<double> us;
+        double recall = 0.0;
+        for (size_t q = 0; q < nq; q++) {
+            auto t0 = Clock::now();
+            exact.search(queries.data() + q * dim, k, hits);
+            us.push_back(micros(t0, Clock::now()));
+            recall += recallOf(q, hits);
+        }
+        snprintf(label, sizeof(label), "exact %s", kernelSets[ki]->name);
+        report(label, us, recall);
+    }
+    exact.setKernels(&dotKernels());
+
+    for (size_t ef : { 16, 32, 64, 128, 256, 512 }) {
+        index.setEf(std::max(ef, k));
+        std::vector<double> us;
+        double recall = 0.0;
+
+        for (size_t q = 0; q < nq; q++) {
+            auto t0 = Clock::now();
+            index.search(queries.data() + q * dim, k, hits);
+            us.push_back(micros(t0, Clock::now()));
+            recall += recallOf(q, hits);
+        }
+
+        snprintf(label, sizeof(label), "hnsw ef=%zu", ef);
+        report(label, us, recall);
+    }
+
+    // shortlist from the graph, final order from the store
+    for (size_t factor : { 2, 4, 8 }) {
+        const size_t shortlist = k * factor;
+        index.setEf(std::max<size_t>(64, shortlist));
+        std::vector<double> us;
+        double recall = 0.0;
+
+        for (size_t q = 0; q < nq; q++) {
+            auto t0 = Clock::now();
+            index.search(queries.data() + q * dim, shortlist, candidates);
+            exact.rerank(queries.data() + q * dim, candidates, k, hits);
+            us.push_back(micros(t0, Clock::now()));
+            recall += recallOf(q, hits);
+        }
+
+        snprintf(label, sizeof(label), "hnsw+rerank %zu", shortlist);
+        report(label, us, recall);
+    }
+    return 0;
+}
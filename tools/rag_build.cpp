@@ -0,0 +1,108 @@
+// Builds a RAG index directory offline:
+//   jarvis_rag_build --model <embedding.gguf> --docs <file|dir> --out <index_dir>
+//                    [--chunk 800] [--overlap 100] [--M 16] [--ef 200] [--gpu-layers 99]
+//                    [--dtype f32|f16|i8]
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/rag/document.h"
+#include "../src/rag/embedder.h"
+#include "../src/rag/hnsw_index.h"
+#include "../src/rag/retriever.h"
+#include "../src/rag/vector_store.h"
+
+static void usage() {
+    std::cerr << "usage: jarvis_rag_build --model <embedding.gguf> --docs <file|dir> --out <index_dir>\n"
+                 "                        [--chunk 800] [--overlap 100] [--M 16] [--ef 200] [--gpu-layers 99]\n"
+                 "                        [--dtype f32|f16|i8]\n";
+}
+
+int main(int argc, char** argv) {
+    std::string model, docs, out;
+    ChunkerConfig chunker;
+    size_t M = 16;
+    size_t efConstruction = 200;
+    int gpuLayers = 99;
+    VectorType dtype = VectorType::F32;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) { usage(); return 1; }
+        const char* value = argv[++i];
+        if      (arg == "--model")      model = value;
+        else if (arg == "--docs")       docs = value;
+        else if (arg == "--out")        out = value;
+        else if (arg == "--chunk")      chunker.max_chars = std::strtoul(value, nullptr, 10);
+        else if (arg == "--overlap")    chunker.overlap_chars = std::strtoul(value, nullptr, 10);
+        else if (arg == "--M")          M = std::strtoul(value, nullptr, 10);
+        else if (arg == "--ef")         efConstruction = std::strtoul(value, nullptr, 10);
+        else if (arg == "--gpu-layers") gpuLayers = std::atoi(value);
+        else if (arg == "--dtype") {
+            if (!VectorStore::parseType(value, dtype)) { usage(); return 1; }
+        }
+        else { usage(); return 1; }
+    }
+
+    if (model.empty() || docs.empty() || out.empty()) {
+        usage();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Document> documents;
+    if (!loadDocuments(docs, documents) || documents.empty()) {
+        std::cerr << "No documents found in " << docs << "\n";
+        return 1;
+    }
+
+    std::vector<Chunk> chunks;
+    for (const Document& doc : documents) {
+        chunkDocument(doc, chunker, chunks);
+    }
+    std::cout << documents.size() << " documents, " << chunks.size() << " chunks\n";
+
+    Embedder embedder;
+    if (!embedder.init(model, gpuLayers)) {
+        std::cerr << "Failed to load embedding model " << model << "\n";
+        return 1;
+    }
+
+    const int dim = embedder.dim();
+    std::vector<float> vectors(chunks.size() * dim);
+    std::vector<float> vec;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!embedder.embed(chunks[i].text, vec)) {
+            std::cerr << "Failed to embed chunk " << i << " of " << chunks[i].source << "\n";
+            return 1;
+        }
+        std::copy(vec.begin(), vec.end(), vectors.begin() + i * dim);
+        if ((i + 1) % 100 == 0) {
+            std::cout << "embedded " << (i + 1) << "/" << chunks.size() << "\n";
+        }
+    }
+
+    HnswIndex index;
+    if (!index.create(dim, chunks.size(), M, efConstruction)) return 1;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (!index.add(vectors.data() + i * dim, i)) return 1;
+    }
+
+    std::filesystem::path dir(out);
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    if (!index.save((dir / RAG_INDEX_FILE).string()) ||
+        !VectorStore::write((dir / RAG_STORE_FILE).string(), dim, dtype, chunks, vectors)) {
+        return 1;
+    }
+
+    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << chunks.size() << " chunks (" << dim << " dims, " << VectorStore::typeName(dtype) << ") to " << out
+              << " in " << seconds << " s\n";
+    return 0;
+}
@@ -0,0 +1,170 @@
+// Whisper throughput benchmark for the TranscriptionService:
+//   jarvis_stt_bench --corpus <file.wav|dir> [--whisper <model>] [--states 2] [--threads 4]
+//                    [--repeat 1] [--no-batch] [--cpu] [--json <out.json>]
+// Every utterance of the corpus (times --repeat) is queued at once and the
+// states work through them. Per-utterance latency percentiles and audio
+// seconds transcribed per wall second are written as JSON to --json or
+// stdout; progress goes to stderr. Run it with --states 1, 2, 4 ... at the
+// same states * threads to see how it scales.
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../src/audio/wav_io.h"
+#include "../src/transcribe/transcription_service.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p * (v.size() - 1) + 0.5);
+    return v[idx];
+}
+
+static void usage() {
+    std::cerr << "usage: jarvis_stt_bench --corpus <file.wav|dir> [--whisper <model>] [--states 2] [--threads 4]\n"
+                 "                        [--repeat 1] [--no-batch] [--cpu] [--json <out.json>]\n";
+}
+
+int main(int argc, char** argv) {
+    std::string corpus;
+    std::string whisperModel = "models/ggml-medium-q8_0.bin";
+    std::string jsonPath;
+    int repeat = 1;
+    TranscriptionServiceConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--no-batch") { config.batch_short = false; continue; }
+        if (arg == "--cpu")      { config.use_gpu = false; continue; }
+        if (i + 1 >= argc) { usage(); return 1; }
+        const char* value = argv[++i];
+        if      (arg == "--corpus")  corpus = value;
+        else if (arg == "--whisper") whisperModel = value;
+        else if (arg == "--states")  config.n_states = std::max(1, std::atoi(value));
+        else if (arg == "--threads") config.threads_per_state = std::max(1, std::atoi(value));
+        else if (arg == "--repeat")  repeat = std::max(1, std::atoi(value));
+        else if (arg == "--json")    jsonPath = value;
+        else { usage(); return 1; }
+    }
+
+    if (corpus.empty()) {
+        usage();
+        return 1;
+    }
+
+    // corpus: one file or every .wav under a directory, sorted for stable output
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (std::filesystem::is_directory(corpus, ec)) {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(corpus, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".wav") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(corpus);
+    }
+
+    std::vector<std::vector<float>> utterances;
+    std::vector<float> audio;
+    for (const std::string& file : files) {
+        if (readWav(file, 16000, audio)) utterances.push_back(audio);
+    }
+    if (utterances.empty()) {
+        std::cerr << "No WAV files in " << corpus << "\n";
+        return 1;
+    }
+
+    const size_t total = utterances.size() * repeat;
+    config.queue_capacity = total;
+
+    TranscriptionService stt;
+    if (!stt.init(whisperModel, config)) {
+        std::cerr << "Failed to init Whisper\n";
+        return 1;
+    }
+
+    // --- run ---
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<TranscriptionResult> results;
+    std::vector<double> latencies;
+    size_t finished = 0;
+
+    auto start = Clock::now();
+    for (int r = 0; r < repeat; r++) {
+        for (const std::vector<float>& utterance : utterances) {
+            auto submitted = Clock::now();
+            bool ok = stt.submit(utterance, [&, submitted](const TranscriptionResult& result) {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.push_back(result);
+                latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - submitted).count());
+                finished++;
+                fprintf(stderr, "%zu/%zu: %.1f s audio, batch %d, %.0f ms queued, %.0f ms decode\n",
+                        finished, total, result.audio_s, result.batch, result.queue_ms, result.decode_ms);
+                cv.notify_one();
+            });
+            if (!ok) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished++;
+            }
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return finished == total; });
+    }
+    const double wallS = std::chrono::duration<double>(Clock::now() - start).count();
+    const TranscriptionStats stats = stt.stats();
+    stt.shutdown();
+
+    // --- report ---
+
+    FILE* out = stdout;
+    if (!jsonPath.empty()) {
+        out = fopen(jsonPath.c_str(), "w");
+        if (!out) {
+            std::cerr << "Failed to write " << jsonPath << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<double> queueMs;
+    double audioS = 0.0;
+    int failed = 0;
+    for (const TranscriptionResult& r : results) {
+        queueMs.push_back(r.queue_ms);
+        audioS += r.audio_s;
+        if (!r.ok) failed++;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": {\"states\": %d, \"threads_per_state\": %d, \"batch_short\": %s, \"utterances\": %zu},\n",
+            config.n_states, config.threads_per_state, config.batch_short ? "true" : "false", total);
+    fprintf(out, "  \"latency\": {\n");
+    fprintf(out, "    \"queue_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f},\n",
+            stats.meanQueueMs(), percentile(queueMs, 0.50), percentile(queueMs, 0.95), percentile(queueMs, 0.99));
+    fprintf(out, "    \"total_ms\": {\"p50\": %.2f, \"p95\": %.2f, \"p99\": %.2f}\n",
+            percentile(latencies, 0.50), percentile(latencies, 0.95), percentile(latencies, 0.99));
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"throughput\": {\"completed\": %zu, \"failed\": %d, \"rejected\": %llu, \"decodes\": %llu, "
+                 "\"batched\": %llu, \"audio_s\": %.2f, \"wall_s\": %.3f, \"audio_s_per_s\": %.2f}\n",
+            results.size(), failed, static_cast<unsigned long long>(stats.rejected),
+            static_cast<unsigned long long>(stats.decodes), static_cast<unsigned long long>(stats.batched),
+            audioS, wallS, audioS / wallS);
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+    return 0;
+}